@@ -0,0 +1,206 @@
+/*
+ * bench.c - Statistics for repeated timing runs
+ *
+ * The bootstrap draws from a fixed-seed xorshift generator, so the same
+ * samples always give the same intervals.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bench.h"
+
+/* A sample and which of the two compared sets it is from */
+typedef struct {
+    double v;
+    int in_a;
+} ranked_t;
+
+static unsigned long long rng;
+
+static void *xmalloc(size_t size);
+static int cmp_double(const void *a, const void *b);
+static int cmp_ranked(const void *a, const void *b);
+static double median(double *x, int n);
+static double resample_median(const double *x, int n, double *tmp);
+static double percentile(double *x, int n, double q);
+static double mann_whitney(const double *a, int na, const double *b, int nb);
+
+/*
+ * bench_summarize - Median, MAD and the bootstrap interval of the median
+ *     of the n samples in x.
+ */
+void bench_summarize(const double *x, int n, bench_summary_t *s)
+{
+    double *tmp = xmalloc(n * sizeof(double));
+    double *meds = xmalloc(BENCH_RESAMPLES * sizeof(double));
+    int i;
+
+    s->n = n;
+    memcpy(tmp, x, n * sizeof(double));
+    s->median = median(tmp, n);
+    for (i = 0; i < n; i++)
+	tmp[i] = fabs(x[i] - s->median);
+    s->mad = median(tmp, n);
+
+    rng = 88172645463325252ULL;
+    for (i = 0; i < BENCH_RESAMPLES; i++)
+	meds[i] = resample_median(x, n, tmp);
+    s->lo = percentile(meds, BENCH_RESAMPLES, BENCH_ALPHA / 2);
+    s->hi = percentile(meds, BENCH_RESAMPLES, 1 - BENCH_ALPHA / 2);
+    free(tmp);
+    free(meds);
+}
+
+/*
+ * bench_compare - How samples b differ from samples a: the relative
+ *     change of the median with its bootstrap interval (a and b are
+ *     resampled independently) and the Mann-Whitney p-value.
+ */
+void bench_compare(const double *a, int na, const double *b, int nb,
+		   bench_compare_t *c)
+{
+    double *tmp = xmalloc((na > nb ? na : nb) * sizeof(double));
+    double *chg = xmalloc(BENCH_RESAMPLES * sizeof(double));
+    double ma;
+    int i;
+
+    memcpy(tmp, a, na * sizeof(double));
+    c->median_a = median(tmp, na);
+    memcpy(tmp, b, nb * sizeof(double));
+    c->median_b = median(tmp, nb);
+    c->change = c->median_b / c->median_a - 1;
+
+    rng = 88172645463325252ULL;
+    for (i = 0; i < BENCH_RESAMPLES; i++) {
+	ma = resample_median(a, na, tmp);
+	chg[i] = resample_median(b, nb, tmp) / ma - 1;
+    }
+    c->lo = percentile(chg, BENCH_RESAMPLES, BENCH_ALPHA / 2);
+    c->hi = percentile(chg, BENCH_RESAMPLES, 1 - BENCH_ALPHA / 2);
+    c->p = mann_whitney(a, na, b, nb);
+    free(tmp);
+    free(chg);
+}
+
+/*
+ * bench_holm - Holm's correction for comparing many traces at once.
+ *     The k-th smallest of the m p-values (from k = 0) rejects if it
+ *     is below alpha / (m - k) and all smaller ones rejected, which
+ *     keeps the chance of any false "significant" within alpha.
+ */
+void bench_holm(const double *p, int m, double alpha, int *reject)
+{
+    int *order = xmalloc(m * sizeof(int));
+    int i, j, t;
+
+    for (i = 0; i < m; i++) {
+	order[i] = i;
+	reject[i] = 0;
+    }
+    for (i = 1; i < m; i++) /* insertion sort of the indices by p */
+	for (j = i; j > 0 && p[order[j]] < p[order[j - 1]]; j--) {
+	    t = order[j];
+	    order[j] = order[j - 1];
+	    order[j - 1] = t;
+	}
+    for (i = 0; i < m && p[order[i]] < alpha / (m - i); i++)
+	reject[order[i]] = 1;
+    free(order);
+}
+
+static void *xmalloc(size_t size)
+{
+    void *p = malloc(size > 0 ? size : 1);
+
+    if (p == NULL)
+	abort();
+    return p;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int cmp_ranked(const void *a, const void *b)
+{
+    return cmp_double(&((const ranked_t *)a)->v, &((const ranked_t *)b)->v);
+}
+
+/* median - Median of x[0..n-1]; sorts x */
+static double median(double *x, int n)
+{
+    qsort(x, n, sizeof(double), cmp_double);
+    return n % 2 ? x[n / 2] : (x[n / 2 - 1] + x[n / 2]) / 2;
+}
+
+/* resample_median - Median of n draws with replacement from x */
+static double resample_median(const double *x, int n, double *tmp)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	tmp[i] = x[rng % n];
+    }
+    return median(tmp, n);
+}
+
+/* percentile - The q quantile of x[0..n-1]; sorts x */
+static double percentile(double *x, int n, double q)
+{
+    int i = (int)(q * (n - 1) + 0.5);
+
+    qsort(x, n, sizeof(double), cmp_double);
+    return x[i];
+}
+
+/*
+ * mann_whitney - Two-sided p-value of the Mann-Whitney U test, with the
+ *     normal approximation corrected for ties and continuity. Needs no
+ *     assumption about the shape of the distributions, only that the
+ *     runs are independent.
+ */
+static double mann_whitney(const double *a, int na, const double *b, int nb)
+{
+    int n = na + nb, i, j, k;
+    ranked_t *r = xmalloc(n * sizeof(ranked_t));
+    double rank_a = 0, ties = 0, u, mean, var, z, t;
+
+    for (i = 0; i < na; i++) {
+	r[i].v = a[i];
+	r[i].in_a = 1;
+    }
+    for (i = 0; i < nb; i++) {
+	r[na + i].v = b[i];
+	r[na + i].in_a = 0;
+    }
+    qsort(r, n, sizeof(ranked_t), cmp_ranked);
+
+    /* Tied values share the average of their ranks */
+    for (i = 0; i < n; i = j) {
+	for (j = i + 1; j < n && r[j].v == r[i].v; j++)
+	    ;
+	t = j - i;
+	ties += t * t * t - t;
+	for (k = i; k < j; k++)
+	    if (r[k].in_a)
+		rank_a += (i + j + 1) / 2.0;
+    }
+    free(r);
+
+    u = rank_a - na * (na + 1) / 2.0;
+    mean = na * (double)nb / 2;
+    var = na * (double)nb / 12 * ((n + 1) - ties / ((double)n * (n - 1)));
+    if (var <= 0)
+	return 1.0; /* all samples equal */
+    z = (fabs(u - mean) - 0.5) / sqrt(var);
+    if (z < 0)
+	z = 0;
+    return erfc(z / sqrt(2.0));
+}
@@ -0,0 +1,41 @@
+/*
+ * bench.h - Statistics for repeated timing runs
+ *
+ * Timing samples are skewed (interrupts and cache misses only ever add
+ * time), so runs are summarized with the median and the median absolute
+ * deviation rather than mean and standard deviation, and intervals are
+ * found by bootstrap resampling rather than from a normal model.
+ */
+#define BENCH_RESAMPLES 2000 /* bootstrap resamples per interval */
+#define BENCH_ALPHA 0.05     /* 95% intervals, and the significance level */
+
+typedef struct {
+    int n;                   /* samples */
+    double median;
+    double mad;              /* median absolute deviation from the median */
+    double lo, hi;           /* bootstrap 95% interval of the median */
+} bench_summary_t;
+
+/* Summarize the n samples in x */
+void bench_summarize(const double *x, int n, bench_summary_t *s);
+
+/*
+ * Compare samples b with samples a: the change of the median,
+ * median(b)/median(a) - 1, with its bootstrap 95% interval, and the
+ * two-sided p-value of the Mann-Whitney U test that a and b come from
+ * the same distribution.
+ */
+typedef struct {
+    double median_a, median_b;
+    double change, lo, hi;
+    double p;
+} bench_compare_t;
+
+void bench_compare(const double *a, int na, const double *b, int nb,
+		   bench_compare_t *c);
+
+/*
+ * Which of m tests with p-values p reject at family-wise level alpha
+ * by Holm's step-down method: reject[i] is set to 1 or 0.
+ */
+void bench_holm(const double *p, int m, double alpha, int *reject);
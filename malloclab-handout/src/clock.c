@@ -9,7 +9,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <time.h>
 #include <sys/times.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
 #include "clock.h"
 
 
@@ -21,9 +31,10 @@
  * You can verify this for yourself using gcc -v.
  *******************************************************/
 
-#if defined(__i386__)  
+#if defined(__i386__) || defined(__x86_64__)
 /*******************************************************
  * Pentium versions of start_counter() and get_counter()
+ * (rdtsc behaves the same in 64-bit mode)
  *******************************************************/
 
 
@@ -108,6 +119,12 @@ static unsigned int counterRoutine[] =
 /* Cast the above instructions into a function. */
 static unsigned int (*counter)(void)= (void *)counterRoutine;
 
+void access_counter(unsigned *hi, unsigned *lo)
+{
+    *hi = 0;
+    *lo = counter();
+}
+
 
 void start_counter()
 {
@@ -143,6 +160,13 @@ double get_counter()
  * haven't provided a Sparc version here.
  ***************************************************************/
 
+void access_counter(unsigned *hi, unsigned *lo)
+{
+    printf("ERROR: You are trying to use an access_counter routine in clock.c\n");
+    printf("that has not been implemented yet on this platform.\n");
+    exit(1);
+}
+
 void start_counter()
 {
     printf("ERROR: You are trying to use a start_counter routine in clock.c\n");
@@ -277,3 +301,178 @@ double get_comp_counter()
     return ctime;
 }
 
+/****************************************************************
+ * Invariant TSC, read with rdtscp
+ *
+ * An invariant TSC ticks at a constant rate whatever the core's
+ * frequency and power state, so it can time code directly once that
+ * rate is known. rdtscp waits for earlier instructions to finish
+ * before reading it, which rdtsc does not.
+ ***************************************************************/
+#if defined(__i386__) || defined(__x86_64__)
+
+#ifndef CLOCK_MONOTONIC_RAW
+#define CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC
+#endif
+
+#define CALIBRATE_NS 10000000 /* length of the fallback calibration */
+
+static double tsc_rate = 0.0; /* MHz, 0 until tsc_mhz has run */
+
+/* Return 1 if the TSC is invariant and rdtscp is available */
+int tsc_usable(void)
+{
+    unsigned a, b, c, d;
+
+    if (!__get_cpuid(0x80000001, &a, &b, &c, &d) || !(d & (1u << 27)))
+	return 0; /* no rdtscp */
+    if (!__get_cpuid(0x80000007, &a, &b, &c, &d) || !(d & (1u << 8)))
+	return 0; /* rate changes with the core frequency */
+    return 1;
+}
+
+unsigned long long read_tsc(void)
+{
+    unsigned hi, lo, aux;
+
+    asm volatile("rdtscp" : "=a" (lo), "=d" (hi), "=c" (aux));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+/* The rate the kernel derived, from the sysfs file some kernels have */
+static double tsc_sysfs(void)
+{
+    FILE *fp;
+    double khz = 0.0;
+
+    if ((fp = fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r")) != NULL) {
+	if (fscanf(fp, "%lf", &khz) != 1)
+	    khz = 0.0;
+	fclose(fp);
+    }
+    return khz / 1e3;
+}
+
+/*
+ * The rate the kernel uses to turn TSC readings into nanoseconds, as
+ * published in the user page of a perf event: ns = tsc * mult >> shift.
+ */
+static double tsc_perf(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    struct perf_event_mmap_page *pg;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    double rate = 0.0;
+    int fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.config = PERF_COUNT_SW_DUMMY;
+    attr.exclude_kernel = 1;
+    if ((fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0)) < 0)
+	return 0.0;
+    pg = mmap(NULL, pagesize, PROT_READ, MAP_SHARED, fd, 0);
+    if (pg != MAP_FAILED) {
+	if (pg->cap_user_time && pg->time_mult != 0)
+	    rate = 1e3 * (double)(1ULL << pg->time_shift) / pg->time_mult;
+	munmap(pg, pagesize);
+    }
+    close(fd);
+    return rate;
+#else
+    return 0.0;
+#endif
+}
+
+/* The rate the processor or the hypervisor reports through cpuid */
+static double tsc_cpuid(void)
+{
+    unsigned a, b, c, d;
+
+    /* Leaf 0x15: crystal clock (Hz) times the TSC/crystal ratio */
+    if (__get_cpuid_max(0, NULL) >= 0x15) {
+	__cpuid_count(0x15, 0, a, b, c, d);
+	if (a != 0 && b != 0 && c != 0)
+	    return (double)c * b / a / 1e6;
+    }
+    /* Leaf 0x40000010 of VMware and KVM guests: TSC rate in kHz */
+    __cpuid(0x40000000, a, b, c, d);
+    if (a >= 0x40000010 && a < 0x40010000) {
+	__cpuid(0x40000010, a, b, c, d);
+	if (a != 0)
+	    return a / 1e3;
+    }
+    return 0.0;
+}
+
+static double ns_raw(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Count TSC ticks over CALIBRATE_NS of CLOCK_MONOTONIC_RAW */
+static double tsc_measure(void)
+{
+    double t0, t1;
+    unsigned long long c0, c1;
+
+    t0 = ns_raw();
+    c0 = read_tsc();
+    do {
+	t1 = ns_raw();
+	c1 = read_tsc();
+    } while (t1 - t0 < CALIBRATE_NS);
+    return (c1 - c0) * 1e3 / (t1 - t0);
+}
+
+/*
+ * tsc_mhz - Return the TSC rate in MHz. Takes the rate the kernel
+ *     reports if it can, then the one cpuid reports, and measures it
+ *     against CLOCK_MONOTONIC_RAW only if neither is known. That takes
+ *     10 ms, not the 2 s of mhz()'s sleep. The result is cached.
+ */
+double tsc_mhz(int verbose)
+{
+    const char *src;
+
+    if (tsc_rate != 0.0)
+	return tsc_rate;
+    if ((tsc_rate = tsc_sysfs()) > 0)
+	src = "kernel, tsc_freq_khz";
+    else if ((tsc_rate = tsc_perf()) > 0)
+	src = "kernel, perf_event";
+    else if ((tsc_rate = tsc_cpuid()) > 0)
+	src = "cpuid";
+    else {
+	tsc_rate = tsc_measure();
+	src = "measured against CLOCK_MONOTONIC_RAW";
+    }
+    if (verbose)
+	printf("TSC rate = %.1f MHz (%s)\n", tsc_rate, src);
+    return tsc_rate;
+}
+
+#else
+
+int tsc_usable(void)
+{
+    return 0;
+}
+
+unsigned long long read_tsc(void)
+{
+    printf("ERROR: There is no TSC on this platform.\n");
+    exit(1);
+}
+
+double tsc_mhz(int verbose)
+{
+    return 0.0;
+}
+
+#endif
@@ -1,5 +1,8 @@
 /* Routines for using cycle counter */
 
+/* Read the raw counter into its high and low 32 bits */
+void access_counter(unsigned *hi, unsigned *lo);
+
 /* Start the counter */
 void start_counter();
 
@@ -20,3 +23,14 @@ double mhz_full(int verbose, int sleeptime);
 void start_comp_counter();
 
 double get_comp_counter();
+
+/** Invariant TSC, read with rdtscp (x86 only) */
+
+/* Is there an invariant TSC and rdtscp to read it? */
+int tsc_usable(void);
+
+/* Read the TSC; waits for earlier instructions to complete */
+unsigned long long read_tsc(void);
+
+/* TSC rate in MHz, as reported by the kernel or cpuid, else measured */
+double tsc_mhz(int verbose);
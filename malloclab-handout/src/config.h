@@ -63,10 +63,13 @@
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
 /*****************************************************************************
- * Set exactly one of these USE_xxx constants to "1" to select a timing method
+ * Set exactly one of these USE_xxx constants to "1" to select the default
+ * timing method; mdriver -T selects another one at run time
  *****************************************************************************/
 #define USE_FCYC   0   /* cycle counter w/K-best scheme (x86 & Alpha only) */
 #define USE_ITIMER 0   /* interval timer (any Unix box) */
-#define USE_GETTOD 1   /* gettimeofday (any Unix box) */
+#define USE_GETTOD 0   /* gettimeofday (any Unix box) */
+#define USE_MONOTONIC 1 /* clock_gettime(CLOCK_MONOTONIC_RAW) (Linux) */
+#define USE_TSC    0   /* invariant TSC read with rdtscp (x86 only) */
 
 #endif /* __CONFIG_H */
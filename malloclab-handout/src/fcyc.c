@@ -8,6 +8,7 @@
  * the time in CPU cycles for a function f.
  */
 #include <stdlib.h>
+#include <string.h>
 #include <sys/times.h>
 #include <stdio.h>
 
@@ -20,18 +21,25 @@
 #define EPSILON 0.01         /* K samples should be EPSILON of each other*/
 #define COMPENSATE 0         /* 1-> try to compensate for clock ticks */
 #define CLEAR_CACHE 0        /* Clear cache before running test function */
-#define CACHE_BYTES (1<<19)  /* Max cache size in bytes */
-#define CACHE_BLOCK 32       /* Cache block size in bytes */
+#define CACHE_BYTES 0        /* Max cache size in bytes (0: ask sysfs) */
+#define CACHE_BLOCK 0        /* Cache block size in bytes (0: ask sysfs) */
+#define GUESS_BYTES (1<<25)  /* Cache size if sysfs doesn't know it */
+#define GUESS_BLOCK 64       /* ... and block size */
+#define FLUSH_FACTOR 2       /* Read this many times the cache size to clear it */
 
 static int kbest = K;
 static int maxsamples = MAXSAMPLES;
 static double epsilon = EPSILON;
 static int compensate = COMPENSATE;
 static int clear_cache = CLEAR_CACHE;
+static test_funct prep = NULL;  /* Untimed setup before each measurement */
 static int cache_bytes = CACHE_BYTES;
 static int cache_block = CACHE_BLOCK;
 
 static int *cache_buf = NULL;
+static int cache_level = 0;  /* Level of the cache found in sysfs, or 0 */
+
+static void detect_cache(void);
 
 static double *values = NULL;
 static int samplecount = 0;
@@ -98,7 +106,11 @@ static int has_converged()
 }
 
 /* 
- * clear - Code to clear cache 
+ * clear - Code to clear cache. Reads FLUSH_FACTOR times the cache
+ *     size, one int per block: replacement is not strictly LRU, so
+ *     reading just the cache size leaves some old lines behind. It
+ *     only reads, so that no dirty lines of the buffer are left to be
+ *     written back while the test function runs.
  */
 static volatile int sink = 0;
 
@@ -106,16 +118,25 @@ static void clear()
 {
     int x = sink;
     int *cptr, *cend;
-    int incr = cache_block/sizeof(int);
+    int incr;
+    if (cache_bytes == 0 || cache_block == 0)
+	detect_cache();
+    incr = cache_block/sizeof(int);
     if (!cache_buf) {
-	cache_buf = malloc(cache_bytes);
+	cache_buf = malloc((size_t)FLUSH_FACTOR*cache_bytes);
 	if (!cache_buf) {
 	    fprintf(stderr, "Fatal error.  Malloc returned null when trying to clear cache\n");
 	    exit(1);
 	}
+	/*
+	 * Write it once, so that every page has a frame of its own (reading
+	 * untouched pages only ever maps the zero page) and page faults
+	 * don't slow down the first clear
+	 */
+	memset(cache_buf, 1, (size_t)FLUSH_FACTOR*cache_bytes);
     }
     cptr = (int *) cache_buf;
-    cend = cptr + cache_bytes/sizeof(int);
+    cend = cptr + (size_t)FLUSH_FACTOR*cache_bytes/sizeof(int);
     while (cptr < cend) {
 	x += *cptr;
 	cptr += incr;
@@ -123,6 +144,84 @@ static void clear()
     sink = x;
 }
 
+/*
+ * read_cache_attr - Read attribute name of cache index i of cpu0 from
+ *     sysfs into buf. Returns 0 if there is no such cache or attribute.
+ */
+static int read_cache_attr(int i, const char *name, char *buf, int len)
+{
+    char path[128];
+    FILE *fp;
+    int ok;
+
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/%s", i, name);
+    if ((fp = fopen(path, "r")) == NULL)
+	return 0;
+    ok = fgets(buf, len, fp) != NULL;
+    fclose(fp);
+    return ok;
+}
+
+/*
+ * detect_cache - Take the cache size and block size that clear() needs
+ *     from the last-level cache in sysfs: the data or unified cache of
+ *     the highest level. Sizes read "48K" or "32M". Falls back to
+ *     GUESS_BYTES and GUESS_BLOCK where sysfs has no caches.
+ */
+static void detect_cache(void)
+{
+    char buf[64], unit;
+    int i, level, size, block, llc_bytes = 0, llc_block = 0;
+
+    for (i = 0; read_cache_attr(i, "level", buf, sizeof(buf)); i++) {
+	level = atoi(buf);
+	unit = 0;
+	if (level <= cache_level ||
+	    !read_cache_attr(i, "type", buf, sizeof(buf)) ||
+	    strncmp(buf, "Instruction", 11) == 0 ||
+	    !read_cache_attr(i, "size", buf, sizeof(buf)) ||
+	    sscanf(buf, "%d%c", &size, &unit) < 1)
+	    continue;
+	if (unit == 'K')
+	    size <<= 10;
+	else if (unit == 'M')
+	    size <<= 20;
+	block = 0;
+	if (read_cache_attr(i, "coherency_line_size", buf, sizeof(buf)))
+	    block = atoi(buf);
+	cache_level = level;
+	llc_bytes = size;
+	llc_block = block;
+    }
+    /* Sizes set with set_fcyc_cache_size/_block take precedence */
+    if (cache_bytes == 0)
+	cache_bytes = llc_bytes > 0 ? llc_bytes : GUESS_BYTES;
+    if (cache_block == 0)
+	cache_block = llc_block > 0 ? llc_block : GUESS_BLOCK;
+}
+
+/*
+ * fcyc_clear_cache - Clear the cache now, as fcyc does before each
+ *     measurement when set_fcyc_clear_cache is on.
+ */
+void fcyc_clear_cache(void)
+{
+    clear();
+}
+
+/*
+ * fcyc_cache_size - The size of the cache that clear() evicts, and its
+ *     level (0 if sysfs didn't report it).
+ */
+int fcyc_cache_size(int *level)
+{
+    if (cache_bytes == 0 || cache_block == 0)
+	detect_cache();
+    if (level)
+	*level = cache_level;
+    return cache_bytes;
+}
+
 /*
  * fcyc - Use K-best scheme to estimate the running time of function f
  */
@@ -133,6 +232,8 @@ double fcyc(test_funct f, void *argp)
     if (compensate) {
 	do {
 	    double cyc;
+	    if (prep)
+		prep(argp);
 	    if (clear_cache)
 		clear();
 	    start_comp_counter();
@@ -143,6 +244,8 @@ double fcyc(test_funct f, void *argp)
     } else {
 	do {
 	    double cyc;
+	    if (prep)
+		prep(argp);
 	    if (clear_cache)
 		clear();
 	    start_counter();
@@ -182,9 +285,19 @@ void set_fcyc_clear_cache(int clear)
     clear_cache = clear;
 }
 
+/*
+ * set_fcyc_prep - When not NULL, prep(argp) runs untimed before each
+ *     measurement, ahead of the cache clearing.
+ *     Default = NULL
+ */
+void set_fcyc_prep(test_funct prep_arg)
+{
+    prep = prep_arg;
+}
+
 /* 
  * set_fcyc_cache_size - Set size of cache to use when clearing cache 
- *     Default = 1<<19 (512KB)
+ *     Default = the last-level cache in sysfs
  */
 void set_fcyc_cache_size(int bytes)
 {
@@ -199,7 +312,7 @@ void set_fcyc_cache_size(int bytes)
 
 /* 
  * set_fcyc_cache_block - Set size of cache block 
- *     Default = 32
+ *     Default = the block size of the last-level cache in sysfs
  */
 void set_fcyc_cache_block(int bytes) {
     cache_block = bytes;
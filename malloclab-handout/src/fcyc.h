@@ -24,18 +24,39 @@ double fcyc(test_funct f, void* argp);
  */
 void set_fcyc_clear_cache(int clear);
 
+/*
+ * set_fcyc_prep - When not NULL, prep(argp) runs untimed before each
+ *     measurement, ahead of the cache clearing, e.g. to reset the
+ *     state that f starts from.
+ *     Default = NULL
+ */
+void set_fcyc_prep(test_funct prep);
+
 /* 
  * set_fcyc_cache_size - Set size of cache to use when clearing cache 
- *     Default = 1<<19 (512KB)
+ *     Default = the last-level cache in sysfs
  */
 void set_fcyc_cache_size(int bytes);
 
 /* 
  * set_fcyc_cache_block - Set size of cache block 
- *     Default = 32
+ *     Default = the block size of the last-level cache in sysfs
  */
 void set_fcyc_cache_block(int bytes);
 
+/*
+ * fcyc_clear_cache - Clear the cache now, e.g. before each run of a
+ *     cold-cache measurement made with another timer
+ */
+void fcyc_clear_cache(void);
+
+/*
+ * fcyc_cache_size - Size in bytes of the cache that is cleared, and
+ *     its level in *level if level isn't NULL (0 if it was not found
+ *     in sysfs)
+ */
+int fcyc_cache_size(int *level);
+
 /* 
  * set_fcyc_compensate- When set, will attempt to compensate for 
  *     timer interrupt overhead 
@@ -2,6 +2,7 @@
  * High-level timing wrappers
  ****************************/
 #include <stdio.h>
+#include <string.h>
 #include "fsecs.h"
 #include "fcyc.h"
 #include "clock.h"
@@ -10,8 +11,67 @@
 
 static double Mhz;  /* estimated CPU clock frequency */
 
+/* The timing package in use; config.h picks the default */
+static enum { FCYC, ITIMER, GETTOD, MONOTONIC, TSC } timer =
+#if USE_FCYC
+    FCYC;
+#elif USE_ITIMER
+    ITIMER;
+#elif USE_GETTOD
+    GETTOD;
+#elif USE_TSC
+    TSC;
+#else
+    MONOTONIC;
+#endif
+
+static const char *timer_names[] = {"fcyc", "itimer", "gettod", "monotonic", "tsc"};
+
+static int cold = 0; /* clear the cache before each timed run? */
+static fsecs_test_funct prep = NULL; /* untimed setup before each run */
+
+#define RUNS 10 /* runs averaged by fsecs */
+
 extern int verbose; /* -v option in mdriver.c */
 
+/*
+ * set_fsecs_timer - Select a timing package by name (see timer_names)
+ *     before init_fsecs. Returns 0, or -1 if there is no such package.
+ */
+int set_fsecs_timer(const char *name)
+{
+    int i;
+
+    for (i = 0; i < sizeof(timer_names) / sizeof(timer_names[0]); i++)
+	if (strcmp(name, timer_names[i]) == 0) {
+	    timer = i;
+	    return 0;
+	}
+    return -1;
+}
+
+/*
+ * set_fsecs_cold - Measure with cold caches (clear them before each
+ *     timed run) or warm ones (run back to back, the default). Call
+ *     before init_fsecs.
+ */
+void set_fsecs_cold(int cold_arg)
+{
+    cold = cold_arg;
+}
+
+/*
+ * set_fsecs_prep - Call prep(argp), untimed, before each run of the
+ *     functions timed from now on, and before the cache is cleared in
+ *     cold mode, so that f doesn't have to reset the state it starts
+ *     from itself. NULL turns it off.
+ */
+void set_fsecs_prep(fsecs_test_funct prep_arg)
+{
+    prep = prep_arg;
+    set_fcyc_prep(prep_arg);
+}
+
 /*
  * init_fsecs - initialize the timing package
  */
@@ -19,24 +79,55 @@ void init_fsecs(void)
 {
     Mhz = 0; /* keep gcc -Wall happy */
 
-#if USE_FCYC
-    if (verbose)
-	printf("Measuring performance with a cycle counter.\n");
-
-    /* set key parameters for the fcyc package */
-    set_fcyc_maxsamples(20); 
-    set_fcyc_clear_cache(1);
-    set_fcyc_compensate(1);
-    set_fcyc_epsilon(0.01);
-    set_fcyc_k(3);
-    Mhz = mhz(verbose > 0);
-#elif USE_ITIMER
-    if (verbose)
-	printf("Measuring performance with the interval timer.\n");
-#elif USE_GETTOD
-    if (verbose)
-	printf("Measuring performance with gettimeofday().\n");
-#endif
+    if (timer == TSC && !tsc_usable()) {
+	if (verbose)
+	    printf("No invariant TSC, using CLOCK_MONOTONIC_RAW instead.\n");
+	timer = MONOTONIC;
+    }
+
+    switch (timer) {
+    case FCYC:
+	if (verbose)
+	    printf("Measuring performance with a cycle counter.\n");
+
+	/* set key parameters for the fcyc package */
+	set_fcyc_maxsamples(20); 
+	set_fcyc_clear_cache(cold);
+	set_fcyc_compensate(1);
+	set_fcyc_epsilon(0.01);
+	set_fcyc_k(3);
+	/* An invariant TSC ticks at its nominal rate, so there's no need
+	   to measure the clock rate by sleeping */
+	Mhz = tsc_usable() ? tsc_mhz(verbose > 0) : mhz(verbose > 0);
+	break;
+    case ITIMER:
+	if (verbose)
+	    printf("Measuring performance with the interval timer.\n");
+	break;
+    case GETTOD:
+	if (verbose)
+	    printf("Measuring performance with gettimeofday().\n");
+	break;
+    case MONOTONIC:
+	if (verbose)
+	    printf("Measuring performance with clock_gettime(CLOCK_MONOTONIC_RAW).\n");
+	break;
+    case TSC:
+	if (verbose)
+	    printf("Measuring performance with the invariant TSC (rdtscp).\n");
+	tsc_mhz(verbose > 0);
+	break;
+    }
+    if (cold && verbose) {
+	int level, bytes = fcyc_cache_size(&level);
+
+	if (level)
+	    printf("Clearing the %d KB L%d cache before each run.\n",
+		   bytes >> 10, level);
+	else
+	    printf("Clearing a %d KB cache (size not in sysfs) before each run.\n",
+		   bytes >> 10);
+    }
 }
 
 /*
@@ -44,14 +135,73 @@ void init_fsecs(void)
  */
 double fsecs(fsecs_test_funct f, void *argp) 
 {
-#if USE_FCYC
-    double cycles = fcyc(f, argp);
-    return cycles/(Mhz*1e6);
-#elif USE_ITIMER
-    return ftimer_itimer(f, argp, 10);
-#elif USE_GETTOD
-    return ftimer_gettod(f, argp, 10);
-#endif 
+    double secs = 0;
+    int i;
+
+    /* Cold runs, and runs with a prep function, are timed one by one,
+       leaving out prep and the clearing */
+    if ((cold || prep) && timer != FCYC) {
+	for (i = 0; i < RUNS; i++) {
+	    if (prep)
+		prep(argp);
+	    if (cold)
+		fcyc_clear_cache();
+	    secs += fsecs_once(f, argp);
+	}
+	return secs / RUNS;
+    }
+
+    switch (timer) {
+    case FCYC:
+	return fcyc(f, argp)/(Mhz*1e6);
+    case ITIMER:
+	return ftimer_itimer(f, argp, RUNS);
+    case GETTOD:
+	return ftimer_gettod(f, argp, RUNS);
+    case TSC:
+	return ftimer_tsc(f, argp, RUNS);
+    case MONOTONIC:
+    default:
+	return ftimer_monotonic(f, argp, RUNS);
+    }
 }
 
+/*
+ * fsecs_once - Return the running time of a single call of f, for
+ *     functions that can't be repeated. Uses the selected clock, or
+ *     CLOCK_MONOTONIC_RAW for the packages that need repetitions.
+ */
+double fsecs_once(fsecs_test_funct f, void *argp)
+{
+    if (timer == TSC)
+	return ftimer_tsc(f, argp, 1);
+    if (timer == GETTOD)
+	return ftimer_gettod(f, argp, 1);
+    return ftimer_monotonic(f, argp, 1);
+}
 
+/*
+ * fsecs_samples - Call f warmup times untimed, then reps more times,
+ *     storing the running time of each of those calls in secs[], so that
+ *     the caller can look at their spread and not just one estimate.
+ *     Each call follows the prep function, if any; in cold mode the
+ *     cache is cleared between the two.
+ */
+void fsecs_samples(fsecs_test_funct f, void *argp, int warmup, int reps,
+		   double *secs)
+{
+    int i;
+
+    for (i = 0; i < warmup; i++) {
+	if (prep)
+	    prep(argp);
+	f(argp);
+    }
+    for (i = 0; i < reps; i++) {
+	if (prep)
+	    prep(argp);
+	if (cold)
+	    fcyc_clear_cache();
+	secs[i] = fsecs_once(f, argp);
+    }
+}
@@ -1,4 +1,10 @@
 typedef void (*fsecs_test_funct)(void *);
 
+int set_fsecs_timer(const char *name); /* fcyc, itimer, gettod, monotonic or tsc */
+void set_fsecs_cold(int cold);          /* clear the cache before each run */
+void set_fsecs_prep(fsecs_test_funct prep); /* untimed setup before each run */
 void init_fsecs(void);
 double fsecs(fsecs_test_funct f, void *argp);
+double fsecs_once(fsecs_test_funct f, void *argp);
+void fsecs_samples(fsecs_test_funct f, void *argp, int warmup, int reps,
+		   double *secs);
@@ -7,10 +7,18 @@
  * Function timers that estimate the running time (in seconds) of a function f.
  *    ftimer_itimer: version that uses the interval timer
  *    ftimer_gettod: version that uses gettimeofday
+ *    ftimer_monotonic: version that uses clock_gettime(CLOCK_MONOTONIC_RAW)
+ *    ftimer_tsc: version that uses the invariant TSC
  */
 #include <stdio.h>
+#include <time.h>
 #include <sys/time.h>
 #include "ftimer.h"
+#include "clock.h"
+
+#ifndef CLOCK_MONOTONIC_RAW
+#define CLOCK_MONOTONIC_RAW CLOCK_MONOTONIC
+#endif
 
 /* function prototypes */
 static void init_etime(void);
@@ -52,6 +60,44 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n)
     return (1E-3*diff);
 }
 
+/* 
+ * ftimer_monotonic - Use clock_gettime(CLOCK_MONOTONIC_RAW) to estimate
+ * the running time of f(argp). Return the average of n runs. Unlike
+ * gettimeofday, the clock has nanosecond resolution and is never
+ * stepped or slewed by NTP.
+ */
+double ftimer_monotonic(ftimer_test_funct f, void *argp, int n)
+{
+    int i;
+    struct timespec sts, ets;
+    double diff;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &sts);
+    for (i = 0; i < n; i++) 
+	f(argp);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ets);
+    diff = (ets.tv_sec - sts.tv_sec) + 1E-9*(ets.tv_nsec - sts.tv_nsec);
+    return diff / n;
+}
+
+/* 
+ * ftimer_tsc - Use the invariant TSC to estimate the running time of
+ * f(argp). Return the average of n runs. The caller must have checked
+ * tsc_usable().
+ */
+double ftimer_tsc(ftimer_test_funct f, void *argp, int n)
+{
+    int i;
+    unsigned long long start;
+    double cycles;
+
+    start = read_tsc();
+    for (i = 0; i < n; i++) 
+	f(argp);
+    cycles = read_tsc() - start;
+    return cycles / (tsc_mhz(0) * 1E6) / n;
+}
+
 
 /*
  * Routines for manipulating the Unix interval timer
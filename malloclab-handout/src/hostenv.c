@@ -0,0 +1,213 @@
+/*
+ * hostenv.c - Quieting and describing the host for timing runs
+ *
+ * Everything but the kernel name comes from Linux interfaces (the CPU
+ * affinity calls, /proc and /sys); elsewhere pinning fails with ENOSYS
+ * and there are no governors to check.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+
+#include "hostenv.h"
+
+#ifdef __linux__
+#define MAX_CPUS CPU_SETSIZE
+#else
+#define MAX_CPUS 0
+#endif
+
+static int read_line(const char *path, char *buf, size_t len);
+static int governor(int cpu, char *buf, size_t len);
+static int allowed(int cpu);
+static int current_cpu(void);
+static void cpu_model(char *buf, size_t len);
+
+/*
+ * hostenv_pin - Keep the process on one CPU, so that the scheduler
+ *     can't move it (and its cache contents) elsewhere mid-run.
+ */
+int hostenv_pin(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+
+    if (cpu < 0 && (cpu = current_cpu()) < 0)
+	return -1;
+    if (cpu >= CPU_SETSIZE) {
+	errno = EINVAL;
+	return -1;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+	return -1;
+    return cpu;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/*
+ * hostenv_raise - Lower the nice value, so that other processes get
+ *     less of the CPU while we run. The policy stays SCHED_OTHER: a
+ *     real-time policy on a long run could starve the kernel threads
+ *     of the CPU we're pinned to.
+ */
+int hostenv_raise(void)
+{
+    return setpriority(PRIO_PROCESS, 0, HOSTENV_NICE);
+}
+
+/*
+ * hostenv_check - Warn about frequency scaling. A CPU may change
+ *     frequency unless its governor is performance, and turbo boost
+ *     changes it even then, with temperature and the load on the
+ *     other cores. CPUs without cpufreq (most virtual machines) have
+ *     nothing to report.
+ */
+int hostenv_check(int cpu)
+{
+    char gov[64], first[64] = "", buf[16];
+    int i, scaling = 0, warnings = 0;
+
+    for (i = 0; i < MAX_CPUS; i++) {
+	if (cpu >= 0 ? i != cpu : !allowed(i))
+	    continue;
+	if (governor(i, gov, sizeof(gov)) == 0 &&
+	    strcmp(gov, "performance") != 0 && scaling++ == 0)
+	    strcpy(first, gov);
+    }
+    if (scaling) {
+	if (cpu >= 0)
+	    printf("WARNING: CPU %d uses the %s frequency governor; ", cpu, first);
+	else
+	    printf("WARNING: %d CPUs use a frequency governor like %s; ",
+		   scaling, first);
+	printf("run times will vary with the frequency.\n");
+	warnings++;
+    }
+    if ((read_line("/sys/devices/system/cpu/intel_pstate/no_turbo",
+		   buf, sizeof(buf)) == 0 && strcmp(buf, "0") == 0) ||
+	(read_line("/sys/devices/system/cpu/cpufreq/boost",
+		   buf, sizeof(buf)) == 0 && strcmp(buf, "1") == 0)) {
+	printf("WARNING: Turbo boost is on; "
+	       "run times will vary with temperature and load.\n");
+	warnings++;
+    }
+    return warnings;
+}
+
+/*
+ * hostenv_describe - Describe the CPU (the pinned one, or the one we
+ *     are on), its governor, our nice value and the kernel.
+ */
+void hostenv_describe(int cpu, char *buf, size_t len)
+{
+    char model[128], gov[64], where[32];
+    struct utsname u;
+    int prio;
+
+    cpu_model(model, sizeof(model));
+    if (cpu >= 0)
+	sprintf(where, "cpu %d", cpu);
+    else
+	strcpy(where, "unpinned");
+    if (governor(cpu >= 0 ? cpu : current_cpu(), gov, sizeof(gov)) < 0)
+	strcpy(gov, "none");
+    errno = 0;
+    prio = getpriority(PRIO_PROCESS, 0);
+    if (errno != 0)
+	prio = 0;
+    if (uname(&u) < 0) {
+	strcpy(u.sysname, "unknown");
+	u.release[0] = u.machine[0] = '\0';
+    }
+    snprintf(buf, len, "%s (%s), governor %s, nice %d, %s %s %s",
+	     where, model, gov, prio, u.sysname, u.release, u.machine);
+}
+
+/*
+ * read_line - Read the first line of a file, without its newline.
+ *     Returns 0, or -1 if there is no such file.
+ */
+static int read_line(const char *path, char *buf, size_t len)
+{
+    FILE *fp;
+    int ok;
+
+    if ((fp = fopen(path, "r")) == NULL)
+	return -1;
+    ok = fgets(buf, len, fp) != NULL;
+    fclose(fp);
+    if (!ok)
+	return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/* governor - The cpufreq governor of cpu; -1 if it has none */
+static int governor(int cpu, char *buf, size_t len)
+{
+    char path[128];
+
+    if (cpu < 0)
+	return -1;
+    sprintf(path, "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+    return read_line(path, buf, len);
+}
+
+/* allowed - Is cpu in our affinity mask? */
+static int allowed(int cpu)
+{
+#ifdef __linux__
+    static cpu_set_t set;
+    static int have = 0;
+
+    if (!have) {
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+	    return 0;
+	have = 1;
+    }
+    return CPU_ISSET(cpu, &set);
+#else
+    return 0;
+#endif
+}
+
+/* current_cpu - The CPU we are running on, or -1 if we can't tell */
+static int current_cpu(void)
+{
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+/* cpu_model - The first model name in /proc/cpuinfo */
+static void cpu_model(char *buf, size_t len)
+{
+    char line[256], *p;
+    FILE *fp;
+
+    snprintf(buf, len, "unknown CPU");
+    if ((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+	return;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (strncmp(line, "model name", 10) == 0 &&
+	    (p = strchr(line, ':')) != NULL) {
+	    p += strspn(p + 1, " \t") + 1;
+	    p[strcspn(p, "\n")] = '\0';
+	    snprintf(buf, len, "%s", p);
+	    break;
+	}
+    }
+    fclose(fp);
+}
@@ -0,0 +1,25 @@
+/*
+ * hostenv.h - Quieting and describing the host for timing runs
+ *
+ * Migrations to other CPUs, competing processes and frequency scaling
+ * all show up in run times. Pinning and a higher priority take care of
+ * the first two where the system allows them; the frequency governor
+ * can only be checked and warned about. The description names the CPU,
+ * governor and kernel, to be kept with the results.
+ */
+#include <stddef.h>
+
+#define HOSTENV_NICE -20  /* nice value asked for by hostenv_raise */
+#define HOSTENV_LINE 256  /* enough for a description */
+
+/* Run on cpu from now on, or on the current CPU if cpu < 0; returns
+   the CPU, or -1 and sets errno */
+int hostenv_pin(int cpu);
+/* Raise the scheduling priority to HOSTENV_NICE; returns 0, or -1 and
+   sets errno (lowering the nice value takes CAP_SYS_NICE) */
+int hostenv_raise(void);
+/* Print a warning for each CPU that cpu (or every CPU we may run on,
+   if cpu < 0) could change frequency on; returns how many */
+int hostenv_check(int cpu);
+/* One line naming the CPU, governor, priority and kernel */
+void hostenv_describe(int cpu, char *buf, size_t len);
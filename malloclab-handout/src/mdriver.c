@@ -9,6 +9,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
@@ -19,6 +20,12 @@
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "mmprof.h"
+#include "mmphase.h"
+#include "mmaccess.h"
+#include "bench.h"
+#include "hostenv.h"
+#include "trace.h"
 #include "config.h"
 
 /**********************
@@ -31,7 +38,7 @@
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
 /* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
+#define IS_ALIGNED(p)  ((((uintptr_t)(p)) % ALIGNMENT) == 0)
 
 /****************************** 
  * The key compound data types 
@@ -44,24 +51,6 @@ typedef struct range_t {
     struct range_t *next;  /* next list element */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
-    int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
-} traceop_t;
-
-/* Holds the information for one trace file*/
-typedef struct {
-    int sugg_heapsize;   /* suggested heap size (unused) */
-    int num_ids;         /* number of alloc/realloc ids */
-    int num_ops;         /* number of distinct requests */
-    int weight;          /* weight for this trace (unused) */
-    traceop_t *ops;      /* array of requests */
-    char **blocks;       /* array of ptrs returned by malloc/realloc... */
-    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
-} trace_t;
-
 /* 
  * Holds the params to the xxx_speed functions, which are timed by fcyc. 
  * This struct is necessary because fcyc accepts only a pointer array
@@ -81,20 +70,68 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    int sbrks;       /* number of mem_sbrk calls for this trace (-1 for libc) */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
 
+/* Summarizes a replay through handles with periodic compaction (-H) */
+typedef struct {
+    int valid;          /* was the trace replayed correctly? */
+    int passes;         /* number of compaction passes */
+    double util;        /* peak payload over footprint for the whole replay */
+    double util_before; /* mean payload over heap in use before a pass */
+    double util_after;  /* ... and right after it */
+    double moved;       /* bytes moved by all passes */
+    double secs;        /* time spent in all passes */
+} hstats_t;
+
+/* Per-run times of the timed mm replays of one trace (-R) */
+typedef struct {
+    char name[MAXLINE]; /* trace file */
+    int n;              /* runs */
+    double *secs;       /* running time of each run */
+    bench_summary_t sum;
+} bstats_t;
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
+static int use_batch = 1; /* replay batch requests with mm_*_batch (reset by -B) */
+static int use_sized = 0; /* free with mm_free_sized (set by -S) */
+static int compact_every = 0; /* replay through handles, compacting every n requests (-H n) */
+static char *prof_file = NULL;  /* write heap profiles to <prof_file>.<trace> (-P) */
+static long prof_rate = MMPROF_RATE; /* mean bytes between profile samples (-r) */
+static int bench_reps = 0;      /* time each replay separately, this many times (-R) */
+static int bench_warmup = 2;    /* untimed replays before those (-w) */
+static int cold_cache = 0;      /* clear the cache before each timed replay (-M cold) */
+static int untimed_reset = 0;   /* speed_prep resets the heap outside the timing */
+static char *bench_save = NULL; /* write the run times to this file (-o) */
+static char *bench_base = NULL; /* compare with the run times in this file (-c) */
+static int pin = 0;             /* pin to a CPU (-C) ... */
+static int pin_cpu = -1;        /* ... this one, or the one we start on if -1 */
+static int raise_prio = 0;      /* raise the scheduling priority (-p) */
+static char host[HOSTENV_LINE]; /* CPU, governor and kernel, for the record */
+
+/* Free-list length over the last util replay, kept by track_free_len */
+#define LEN_POINTS 10
+static double len_sum;               /* summed over all requests */
+static size_t len_max;
+static size_t len_at[LEN_POINTS];    /* at the end of each tenth of the trace */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
+/* Requests whose metadata accesses mmaccess counts, by request type */
+#define ACCESS_INIT (CALLOC + 1)
+static const char *const access_names[] = {
+    [ALLOC] = "malloc", [FREE] = "free", [REALLOC] = "realloc",
+    [ALLOC_BATCH] = "malloc_batch", [FREE_BATCH] = "free_batch",
+    [MEMALIGN] = "memalign", [CALLOC] = "calloc", [ACCESS_INIT] = "mm_init"};
+
 /* The filenames of the default tracefiles */
 static char *default_tracefiles[] = {  
     DEFAULT_TRACEFILES, NULL
@@ -123,10 +160,36 @@ static void eval_libc_speed(void *ptr);
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static void speed_prep(void *ptr);
 static void eval_mm_speed(void *ptr);
 
+/* Replay batch requests with the mm package */
+static int malloc_batch(int size, int count, char **blocks);
+static void free_batch(char **blocks, int count);
+static void free_block(char *p, size_t size);
+static char *memalign_block(int align, int size, int *rawsize);
+static char *calloc_block(int size);
+
+/* Replay a trace through the handle API of a compacting package */
+static int eval_mm_handles(trace_t *trace, int tracenum, hstats_t *hs);
+static int halloc_block(trace_t *trace, mm_handle_t *handles, int index,
+			int size, int tracenum, int opnum);
+static int compact_pass(trace_t *trace, mm_handle_t *handles, size_t live,
+			int tracenum, int opnum, hstats_t *hs);
+static void compact_funct(void *argp);
+static void printhresults(int n, hstats_t *hstats);
+
+/* Benchmark mode: median and spread of many runs, and comparisons */
+static void printbresults(int n, bstats_t *bstats);
+static void save_bench(int n, bstats_t *bstats);
+static void compare_bench(int n, bstats_t *bstats);
+
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void print_heap_stats(void);
+static void track_free_len(int opnum, int num_ops);
+static void print_search_stats(int num_ops);
+static void write_profile(int tracenum);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -144,7 +207,9 @@ int main(int argc, char **argv)
     trace_t *trace = NULL;     /* stores a single trace file in memory */
     range_t *ranges = NULL;    /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
-    stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
+    stats_t *mm_results = NULL;/* mm (i.e. student) stats for each trace */
+    hstats_t *mm_hstats = NULL;/* mm handle replay stats for each trace */
+    bstats_t *mm_bstats = NULL;/* mm run times for each trace (-R) */
     speed_t speed_params;      /* input parameters to the xx_speed routines */ 
 
     int team_check = 1;  /* If set, check team structure (reset by -a) */
@@ -158,7 +223,7 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:hvVgalBSpH:P:r:T:M:R:w:o:c:C:")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -184,6 +249,76 @@ int main(int argc, char **argv)
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 'B': /* Replay batch requests one block at a time */
+            use_batch = 0;
+            break;
+        case 'S': /* Pass the size from the trace to mm_free_sized */
+            use_sized = 1;
+            break;
+        case 'H': /* Replay through handles and compact every n requests */
+            if ((compact_every = atoi(optarg)) <= 0) {
+		usage();
+		exit(1);
+	    }
+            if (!mm_halloc || !mm_compact) {
+		printf("ERROR: -H needs a package with the handle API "
+		       "(mm_halloc, mm_compact, ...)\n");
+		exit(1);
+	    }
+            break;
+        case 'P': /* Profile the timed replays */
+            prof_file = optarg;
+            break;
+        case 'r': /* Mean bytes between profile samples */
+            if ((prof_rate = atol(optarg)) <= 0) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'T': /* Timing package */
+            if (set_fsecs_timer(optarg) < 0) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'M': /* Cache state at the start of each timed replay */
+            if (!strcmp(optarg, "cold"))
+		cold_cache = 1;
+            else if (!strcmp(optarg, "warm"))
+		cold_cache = 0;
+            else {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'R': /* Benchmark mode: time each of n replays */
+            if ((bench_reps = atoi(optarg)) < 2) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'w': /* Untimed replays before the timed ones of -R */
+            if ((bench_warmup = atoi(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'o': /* Save the run times of -R */
+            bench_save = optarg;
+            break;
+        case 'c': /* Compare the run times of -R with saved ones */
+            bench_base = optarg;
+            break;
+        case 'C': /* Pin to a CPU */
+            pin = 1;
+            if ((pin_cpu = atoi(optarg)) < -1) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'p': /* Raise the scheduling priority */
+            raise_prio = 1;
+            break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -199,6 +334,11 @@ int main(int argc, char **argv)
         }
     }
 	
+    if ((bench_save || bench_base) && !bench_reps) {
+	printf("ERROR: -o and -c need -R\n");
+	exit(1);
+    }
+
     /* 
      * Check and print team info 
      */
@@ -235,9 +375,24 @@ int main(int argc, char **argv)
 	printf("Using default tracefiles in %s\n", tracedir);
     }
 
+    /* Keep other work off the CPU we time on, and say what it is */
+    if (pin && (pin_cpu = hostenv_pin(pin_cpu)) < 0)
+	printf("WARNING: Could not pin to a CPU: %s\n", strerror(errno));
+    if (raise_prio && hostenv_raise() < 0)
+	printf("WARNING: Could not raise the priority: %s\n", strerror(errno));
+    hostenv_check(pin_cpu);
+    hostenv_describe(pin_cpu, host, sizeof(host));
+    if (verbose || bench_reps)
+	printf("Host: %s\n", host);
+
     /* Initialize the timing package */
+    set_fsecs_cold(cold_cache);
     init_fsecs();
 
+    /* The profiler samples the timed mm replays, so -P shows its cost */
+    if (prof_file)
+	mmprof_init(prof_rate);
+
     /*
      * Optionally run and evaluate the libc malloc package 
      */
@@ -254,6 +409,7 @@ int main(int argc, char **argv)
 	for (i=0; i < num_tracefiles; i++) {
 	    trace = read_trace(tracedir, tracefiles[i]);
 	    libc_stats[i].ops = trace->num_ops;
+	    libc_stats[i].sbrks = -1;
 	    if (verbose > 1)
 		printf("Checking libc malloc for correctness, ");
 	    libc_stats[i].valid = eval_libc_valid(trace, i);
@@ -280,29 +436,77 @@ int main(int argc, char **argv)
 	printf("\nTesting mm malloc\n");
 
     /* Allocate the mm stats array, with one stats_t struct per tracefile */
-    mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
-    if (mm_stats == NULL)
-	unix_error("mm_stats calloc in main failed");
+    mm_results = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+    if (mm_results == NULL)
+	unix_error("mm_results calloc in main failed");
+    if (compact_every) {
+	mm_hstats = (hstats_t *)calloc(num_tracefiles, sizeof(hstats_t));
+	if (mm_hstats == NULL)
+	    unix_error("mm_hstats calloc in main failed");
+    }
+    if (bench_reps) {
+	mm_bstats = (bstats_t *)calloc(num_tracefiles, sizeof(bstats_t));
+	if (mm_bstats == NULL)
+	    unix_error("mm_bstats calloc in main failed");
+    }
     
     /* Initialize the simulated memory system in memlib.c */
     mem_init(); 
 
+    /* Cold and per-run timing reset the heap untimed, before the
+       clearing; the default timing keeps the reset in the replay */
+    if (cold_cache || bench_reps) {
+	set_fsecs_prep(speed_prep);
+	untimed_reset = 1;
+    }
+
     /* Evaluate student's mm malloc package using the K-best scheme */
     for (i=0; i < num_tracefiles; i++) {
 	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
+	mm_results[i].ops = trace->num_ops;
 	if (verbose > 1)
 	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
+	mm_results[i].valid = eval_mm_valid(trace, i, &ranges);
+	if (mm_results[i].valid) {
 	    if (verbose > 1)
 		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
+	    mm_results[i].util = eval_mm_util(trace, i, &ranges);
+	    mm_results[i].sbrks = mem_sbrkcount();
 	    speed_params.trace = trace;
 	    speed_params.ranges = ranges;
 	    if (verbose > 1)
 		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
+	    if (bench_reps) {
+		bstats_t *bs = &mm_bstats[i];
+
+		strcpy(bs->name, tracefiles[i]);
+		if ((bs->secs = malloc(bench_reps * sizeof(double))) == NULL)
+		    unix_error("malloc of bench samples failed");
+		bs->n = bench_reps;
+		fsecs_samples(eval_mm_speed, &speed_params, bench_warmup,
+			      bench_reps, bs->secs);
+		bench_summarize(bs->secs, bs->n, &bs->sum);
+		mm_results[i].secs = bs->sum.median;
+	    }
+	    else
+		mm_results[i].secs = fsecs(eval_mm_speed, &speed_params);
+	    if (prof_file)
+		write_profile(i);
+	    if (verbose > 1 && mm_print_stats)
+		mm_print_stats();
+	    if (verbose > 1) {
+		print_heap_stats();
+		print_search_stats(trace->num_ops);
+		mmphase_print();
+		mmaccess_print();
+	    }
+	    if (compact_every) {
+		if (verbose > 1)
+		    printf("Replaying through handles.\n");
+		eval_mm_handles(trace, i, &mm_hstats[i]);
+		if (verbose > 1 && mm_print_stats)
+		    mm_print_stats();
+	    }
 	}
 	free_trace(trace);
     }
@@ -310,9 +514,26 @@ int main(int argc, char **argv)
     /* Display the mm results in a compact table */
     if (verbose) {
 	printf("\nResults for mm malloc:\n");
-	printresults(num_tracefiles, mm_stats);
+	printresults(num_tracefiles, mm_results);
+	printf("\n");
+    }
+    if (compact_every) {
+	printf("Handle replay, compacting every %d requests:\n", compact_every);
+	printhresults(num_tracefiles, mm_hstats);
 	printf("\n");
     }
+    if (bench_reps) {
+	printf("Run times, %d runs after %d warm-up runs per trace:\n",
+	       bench_reps, bench_warmup);
+	printbresults(num_tracefiles, mm_bstats);
+	printf("\n");
+	if (bench_save)
+	    save_bench(num_tracefiles, mm_bstats);
+	if (bench_base) {
+	    compare_bench(num_tracefiles, mm_bstats);
+	    printf("\n");
+	}
+    }
 
     /* 
      * Accumulate the aggregate statistics for the student's mm package 
@@ -322,10 +543,10 @@ int main(int argc, char **argv)
     util = 0;
     numcorrect = 0;
     for (i=0; i < num_tracefiles; i++) {
-	secs += mm_stats[i].secs;
-	ops += mm_stats[i].ops;
-	util += mm_stats[i].util;
-	if (mm_stats[i].valid)
+	secs += mm_results[i].secs;
+	ops += mm_results[i].ops;
+	util += mm_results[i].util;
+	if (mm_results[i].valid)
 	    numcorrect++;
     }
     avg_mm_util = util/num_tracefiles;
@@ -395,9 +616,8 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    /* The payload must lie within the extent of a live region or mapping */
+    if (!mem_in_region(lo, hi) && !mem_in_map(lo, hi)) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
@@ -469,41 +689,21 @@ static void clear_ranges(range_t **ranges)
  *********************************************/
 
 /*
- * read_trace - read a trace file and store it in memory
+ * read_trace - read a trace file and store it in memory, with room
+ *              for the blocks it allocates
  */
 static trace_t *read_trace(char *tracedir, char *filename)
 {
-    FILE *tracefile;
     trace_t *trace;
-    char type[MAXLINE];
     char path[MAXLINE];
-    unsigned index, size;
-    unsigned max_index = 0;
-    unsigned op_index;
 
     if (verbose > 1)
 	printf("Reading tracefile: %s\n", filename);
 
-    /* Allocate the trace record */
-    if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
-	unix_error("malloc 1 failed in read_trance");
-	
-    /* Read the trace file header */
     strcpy(path, tracedir);
     strcat(path, filename);
-    if ((tracefile = fopen(path, "r")) == NULL) {
-	sprintf(msg, "Could not open %s in read_trace", path);
-	unix_error(msg);
-    }
-    fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
-    fscanf(tracefile, "%d", &(trace->num_ids));     
-    fscanf(tracefile, "%d", &(trace->num_ops));     
-    fscanf(tracefile, "%d", &(trace->weight));        /* not used */
-    
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops = 
-	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-	unix_error("malloc 2 failed in read_trace");
+    if ((trace = trace_read(path)) == NULL)
+	exit(1);
 
     /* We'll keep an array of pointers to the allocated blocks here... */
     if ((trace->blocks = 
@@ -515,42 +715,6 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
 	unix_error("malloc 4 failed in read_trace");
     
-    /* read every request line in the trace file */
-    index = 0;
-    op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-	switch(type[0]) {
-	case 'a':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = ALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'r':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = REALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'f':
-	    fscanf(tracefile, "%ud", &index);
-	    trace->ops[op_index].type = FREE;
-	    trace->ops[op_index].index = index;
-	    break;
-	default:
-	    printf("Bogus type character (%c) in tracefile %s\n", 
-		   type[0], path);
-	    exit(1);
-	}
-	op_index++;
-	
-    }
-    fclose(tracefile);
-    assert(max_index == trace->num_ids - 1);
-    assert(trace->num_ops == op_index);
-    
     return trace;
 }
 
@@ -560,10 +724,7 @@ static trace_t *read_trace(char *tracedir, char *filename)
  */
 void free_trace(trace_t *trace)
 {
-    free(trace->ops);         /* free the three arrays... */
-    free(trace->blocks);      
-    free(trace->block_sizes);
-    free(trace);              /* and the trace record itself... */
+    trace_free(trace);
 }
 
 /**********************************************************************
@@ -579,6 +740,8 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     int i, j;
     int index;
     int size;
+    int count;
+    int align, rawsize;
     int oldsize;
     char *newp;
     char *oldp;
@@ -653,7 +816,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -671,7 +834,71 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Remove region from list and call student's free function */
 	    p = trace->blocks[index];
 	    remove_range(ranges, p);
-	    mm_free(p);
+	    free_block(p, trace->block_sizes[index]);
+	    break;
+
+	case MEMALIGN: /* mm_memalign */
+	    align = trace->ops[i].align;
+	    if ((p = memalign_block(align, size, &rawsize)) == NULL) {
+		malloc_error(tracenum, i, "mm_memalign failed.");
+		return 0;
+	    }
+	    if (mm_memalign && ((unsigned long)p % align) != 0) {
+		sprintf(msg, "Payload address (%p) not aligned to %d bytes",
+			p, align);
+		malloc_error(tracenum, i, msg);
+		return 0;
+	    }
+	    if (add_range(ranges, p, rawsize, tracenum, i) == 0)
+		return 0;
+	    memset(p, index & 0xFF, rawsize);
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
+	case CALLOC: /* mm_calloc */
+	    if ((p = calloc_block(size)) == NULL) {
+		malloc_error(tracenum, i, "mm_calloc failed.");
+		return 0;
+	    }
+	    if (add_range(ranges, p, size, tracenum, i) == 0)
+		return 0;
+
+	    /* The block must come back zeroed before we fill it */
+	    for (j = 0; j < size; j++) {
+		if (p[j] != 0) {
+		    malloc_error(tracenum, i, "mm_calloc returned a block "
+				 "that is not zeroed");
+		    return 0;
+		}
+	    }
+	    memset(p, index & 0xFF, size);
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    break;
+
+	case ALLOC_BATCH: /* mm_malloc_batch */
+	    count = trace->ops[i].count;
+	    if (malloc_batch(size, count, &trace->blocks[index]) < count) {
+		malloc_error(tracenum, i, "mm_malloc_batch failed.");
+		return 0;
+	    }
+
+	    /* Check and fill every block of the batch like a single alloc */
+	    for (j = index; j < index + count; j++) {
+		p = trace->blocks[j];
+		if (add_range(ranges, p, size, tracenum, i) == 0)
+		    return 0;
+		memset(p, j & 0xFF, size);
+		trace->block_sizes[j] = size;
+	    }
+	    break;
+
+	case FREE_BATCH: /* mm_free_batch */
+	    count = trace->ops[i].count;
+	    for (j = index; j < index + count; j++)
+		remove_range(ranges, trace->blocks[j]);
+	    free_batch(&trace->blocks[index], count);
 	    break;
 
 	default:
@@ -692,14 +919,16 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   size of the heap in bytes after running the student's malloc 
  *   package on the trace. Note that our implementation of mem_sbrk() 
  *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
+ *   is always the high water mark of the heap. Blocks served from
+ *   dedicated mappings (mem_map) count too: heapsize is the high water
+ *   mark of heap plus mapped bytes, as reported by mem_footprint().
  *   
  */
 static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 {   
-    int i;
+    int i, j;
     int index;
-    int size, newsize, oldsize;
+    int size, newsize, oldsize, count, rawsize;
     int max_total_size = 0;
     int total_size = 0;
     char *p;
@@ -707,17 +936,28 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
+    mmaccess_start(access_names, ACCESS_INIT + 1);
+    mmaccess_op(ACCESS_INIT);
     if (mm_init() < 0)
 	app_error("mm_init failed in eval_mm_util");
+    len_sum = 0;
+    len_max = 0;
+    memset(len_at, 0, sizeof(len_at));
 
     for (i = 0;  i < trace->num_ops;  i++) {
+	mmaccess_op(trace->ops[i].type);
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_alloc */
+        case CALLOC: /* mm_calloc */
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if (trace->ops[i].type == CALLOC)
+		p = calloc_block(size);
+	    else
+		p = mm_malloc(size);
+	    if (p == NULL)
 		app_error("mm_malloc failed in eval_mm_util");
 	    
 	    /* Remember region and size */
@@ -760,7 +1000,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    size = trace->block_sizes[index];
 	    p = trace->blocks[index];
 	    
-	    mm_free(p);
+	    free_block(p, size);
 	    
 	    /* Keep track of current total size
 	     * of all allocated blocks */
@@ -768,28 +1008,88 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    break;
 
+	case MEMALIGN: /* mm_memalign */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+
+	    if ((p = memalign_block(trace->ops[i].align, size, &rawsize)) == NULL)
+		app_error("mm_memalign failed in eval_mm_util");
+	    trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+
+	    /* Only the aligned payload counts, not any over-allocation */
+	    total_size += size;
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
+	case ALLOC_BATCH: /* mm_malloc_batch */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    count = trace->ops[i].count;
+
+	    if (malloc_batch(size, count, &trace->blocks[index]) < count)
+		app_error("mm_malloc_batch failed in eval_mm_util");
+	    for (j = index; j < index + count; j++)
+		trace->block_sizes[j] = size;
+
+	    total_size += size * count;
+	    max_total_size = (total_size > max_total_size) ?
+		total_size : max_total_size;
+	    break;
+
+	case FREE_BATCH: /* mm_free_batch */
+	    index = trace->ops[i].index;
+	    count = trace->ops[i].count;
+	    for (j = index; j < index + count; j++)
+		total_size -= trace->block_sizes[j];
+	    free_batch(&trace->blocks[index], count);
+	    break;
+
 	default:
 	    app_error("Nonexistent request type in eval_mm_util");
 
         }
+	if (mm_search_stats)
+	    track_free_len(i, trace->num_ops);
     }
+    mmaccess_stop();
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    return ((double)max_total_size / (double)mem_footprint());
 }
 
 
+/*
+ * speed_prep - Reset the heap, and the profile taken from it, before
+ *    each run of eval_mm_speed with -M cold or -R. fsecs calls it
+ *    outside the timed region and, in cold mode, before clearing the
+ *    cache. It also zeroes the old heap at once, which mem_sbrk would
+ *    otherwise do during the run, warming the cache up again.
+ */
+static void speed_prep(void *ptr)
+{
+    mem_reset_brk();
+    mem_zero_brk();
+    if (prof_file)
+	mmprof_reset();
+}
+
 /*
  * eval_mm_speed - This is the function that is used by fcyc()
  *    to measure the running time of the mm malloc package.
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index, size, newsize;
+    int i, j, index, size, newsize, rawsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
-    /* Reset the heap and initialize the mm package */
-    mem_reset_brk();
+    /* Reset the heap, unless speed_prep did, and initialize the mm package */
+    if (!untimed_reset) {
+	mem_reset_brk();
+	if (prof_file)
+	    mmprof_reset();
+    }
     if (mm_init() < 0) 
 	app_error("mm_init failed in eval_mm_speed");
 
@@ -802,24 +1102,63 @@ static void eval_mm_speed(void *ptr)
             size = trace->ops[i].size;
             if ((p = mm_malloc(size)) == NULL)
 		app_error("mm_malloc error in eval_mm_speed");
+            MMPROF_MALLOC(p, size);
             trace->blocks[index] = p;
             break;
 
+	case CALLOC: /* mm_calloc */
+	    index = trace->ops[i].index;
+	    if ((p = calloc_block(trace->ops[i].size)) == NULL)
+		app_error("mm_calloc error in eval_mm_speed");
+	    MMPROF_MALLOC(p, trace->ops[i].size);
+	    trace->blocks[index] = p;
+	    break;
+
 	case REALLOC: /* mm_realloc */
 	    index = trace->ops[i].index;
             newsize = trace->ops[i].size;
 	    oldp = trace->blocks[index];
+	    MMPROF_FREE(oldp);
             if ((newp = mm_realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc error in eval_mm_speed");
+            MMPROF_MALLOC(newp, newsize);
             trace->blocks[index] = newp;
             break;
 
         case FREE: /* mm_free */
             index = trace->ops[i].index;
             block = trace->blocks[index];
-            mm_free(block);
+            /* block_sizes was left behind by eval_mm_util */
+            MMPROF_FREE(block);
+            free_block(block, trace->block_sizes[index]);
             break;
 
+	case MEMALIGN: /* mm_memalign */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    if ((p = memalign_block(trace->ops[i].align, size, &rawsize)) == NULL)
+		app_error("mm_memalign error in eval_mm_speed");
+	    MMPROF_MALLOC(p, size);
+	    trace->blocks[index] = p;
+	    break;
+
+	case ALLOC_BATCH: /* mm_malloc_batch */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    if (malloc_batch(size, trace->ops[i].count,
+			     &trace->blocks[index]) < trace->ops[i].count)
+		app_error("mm_malloc_batch error in eval_mm_speed");
+	    for (j = index; j < index + trace->ops[i].count; j++)
+		MMPROF_MALLOC(trace->blocks[j], size);
+	    break;
+
+	case FREE_BATCH: /* mm_free_batch */
+	    index = trace->ops[i].index;
+	    for (j = index; j < index + trace->ops[i].count; j++)
+		MMPROF_FREE(trace->blocks[j]);
+	    free_batch(&trace->blocks[index], trace->ops[i].count);
+	    break;
+
 	default:
 	    app_error("Nonexistent request type in eval_mm_valid");
         }
@@ -833,7 +1172,7 @@ static void eval_mm_speed(void *ptr)
  */
 static int eval_libc_valid(trace_t *trace, int tracenum)
 {
-    int i, newsize;
+    int i, j, newsize;
     char *p, *newp, *oldp;
 
     for (i = 0;  i < trace->num_ops;  i++) {
@@ -861,6 +1200,38 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 	    free(trace->blocks[trace->ops[i].index]);
 	    break;
 
+	case CALLOC: /* calloc */
+	    if ((p = calloc(1, trace->ops[i].size)) == NULL) {
+		malloc_error(tracenum, i, "libc calloc failed");
+		unix_error("System message");
+	    }
+	    trace->blocks[trace->ops[i].index] = p;
+	    break;
+
+	case MEMALIGN: /* posix_memalign */
+	    if (posix_memalign((void **)&p, trace->ops[i].align,
+			       trace->ops[i].size) != 0) {
+		malloc_error(tracenum, i, "libc posix_memalign failed");
+		unix_error("System message");
+	    }
+	    trace->blocks[trace->ops[i].index] = p;
+	    break;
+
+	case ALLOC_BATCH: /* libc has no batch malloc: one block at a time */
+	    for (j = 0; j < trace->ops[i].count; j++) {
+		if ((p = malloc(trace->ops[i].size)) == NULL) {
+		    malloc_error(tracenum, i, "libc malloc failed");
+		    unix_error("System message");
+		}
+		trace->blocks[trace->ops[i].index + j] = p;
+	    }
+	    break;
+
+	case FREE_BATCH: /* free */
+	    for (j = 0; j < trace->ops[i].count; j++)
+		free(trace->blocks[trace->ops[i].index + j]);
+	    break;
+
 	default:
 	    app_error("invalid operation type  in eval_libc_valid");
 	}
@@ -876,7 +1247,7 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
  */
 static void eval_libc_speed(void *ptr)
 {
-    int i;
+    int i, j;
     int index, size, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
@@ -906,8 +1277,286 @@ static void eval_libc_speed(void *ptr)
 	    block = trace->blocks[index];
 	    free(block);
 	    break;
+
+	case CALLOC: /* calloc */
+	    index = trace->ops[i].index;
+	    if ((p = calloc(1, trace->ops[i].size)) == NULL)
+		unix_error("calloc failed in eval_libc_speed");
+	    trace->blocks[index] = p;
+	    break;
+
+	case MEMALIGN: /* posix_memalign */
+	    index = trace->ops[i].index;
+	    if (posix_memalign((void **)&p, trace->ops[i].align,
+			       trace->ops[i].size) != 0)
+		unix_error("posix_memalign failed in eval_libc_speed");
+	    trace->blocks[index] = p;
+	    break;
+
+	case ALLOC_BATCH: /* one block at a time */
+	    index = trace->ops[i].index;
+	    size = trace->ops[i].size;
+	    for (j = 0; j < trace->ops[i].count; j++) {
+		if ((p = malloc(size)) == NULL)
+		    unix_error("malloc failed in eval_libc_speed");
+		trace->blocks[index + j] = p;
+	    }
+	    break;
+
+	case FREE_BATCH: /* free */
+	    index = trace->ops[i].index;
+	    for (j = 0; j < trace->ops[i].count; j++)
+		free(trace->blocks[index + j]);
+	    break;
+	}
+    }
+}
+
+/*
+ * malloc_batch - Allocate count blocks of size bytes into blocks[],
+ *     with mm_malloc_batch if the package has it and -B wasn't given,
+ *     else one mm_malloc at a time. Returns the number allocated.
+ */
+static int malloc_batch(int size, int count, char **blocks)
+{
+    int j;
+
+    if (use_batch && mm_malloc_batch)
+	return (int)mm_malloc_batch(size, count, (void **)blocks);
+    for (j = 0; j < count; j++)
+	if ((blocks[j] = mm_malloc(size)) == NULL)
+	    break;
+    return j;
+}
+
+/*
+ * free_block - Free p, which was last allocated with size bytes, with
+ *     mm_free_sized if -S was given and the package has it, else with
+ *     mm_free.
+ */
+static void free_block(char *p, size_t size)
+{
+    if (use_sized && mm_free_sized)
+	mm_free_sized(p, size);
+    else
+	mm_free(p);
+}
+
+/*
+ * memalign_block - Allocate size bytes aligned to align with mm_memalign.
+ *     A package without it gets the over-allocation its callers would
+ *     have to make, mm_malloc(size + align - ALIGNMENT), so that the
+ *     waste shows up in its utilization. *rawsize is set to the number
+ *     of bytes actually requested.
+ */
+static char *memalign_block(int align, int size, int *rawsize)
+{
+    if (mm_memalign) {
+	*rawsize = size;
+	return mm_memalign(align, size);
+    }
+    *rawsize = size + (align > ALIGNMENT ? align - ALIGNMENT : 0);
+    return mm_malloc(*rawsize);
+}
+
+/*
+ * calloc_block - Allocate size zeroed bytes with mm_calloc, or with
+ *     mm_malloc and a memset for a package that doesn't have it.
+ */
+static char *calloc_block(int size)
+{
+    char *p;
+
+    if (mm_calloc)
+	return mm_calloc(1, size);
+    if ((p = mm_malloc(size)) != NULL)
+	memset(p, 0, size);
+    return p;
+}
+
+/*
+ * eval_mm_handles - Replay a trace through mm_halloc/mm_hrealloc/
+ *     mm_hfree and call mm_compact every compact_every requests. Each
+ *     block is pinned only while the driver writes or checks it, so
+ *     every block may move during a pass. Compaction can't keep an
+ *     alignment, so memalign requests are replayed as plain allocations.
+ */
+static int eval_mm_handles(trace_t *trace, int tracenum, hstats_t *hs)
+{
+    mm_handle_t *handles;
+    int i, j, index, size, oldsize;
+    size_t live = 0, max_live = 0;
+    unsigned char *p;
+
+    memset(hs, 0, sizeof(hstats_t));
+    if ((handles = (mm_handle_t *)calloc(trace->num_ids,
+					 sizeof(mm_handle_t))) == NULL)
+	unix_error("calloc failed in eval_mm_handles");
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	malloc_error(tracenum, 0, "mm_init failed.");
+	free(handles);
+	return 0;
+    }
+
+    for (i = 0; i < trace->num_ops; i++) {
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+
+	switch (trace->ops[i].type) {
+
+	case ALLOC: /* mm_halloc */
+	case CALLOC:
+	case MEMALIGN:
+	    if (!halloc_block(trace, handles, index, size, tracenum, i))
+		goto fail;
+	    live += size;
+	    break;
+
+	case ALLOC_BATCH: /* one mm_halloc per block */
+	    for (j = index; j < index + trace->ops[i].count; j++) {
+		if (!halloc_block(trace, handles, j, size, tracenum, i))
+		    goto fail;
+		live += size;
+	    }
+	    break;
+
+	case REALLOC: /* mm_hrealloc */
+	    if (mm_hrealloc(handles[index], size) < 0) {
+		malloc_error(tracenum, i, "mm_hrealloc failed.");
+		goto fail;
+	    }
+	    oldsize = trace->block_sizes[index];
+	    p = mm_pin(handles[index]);
+	    for (j = 0; j < oldsize && j < size; j++) {
+		if ((unsigned char)p[j] != (index & 0xFF)) {
+		    malloc_error(tracenum, i, "mm_hrealloc did not preserve "
+				 "the data from old block");
+		    goto fail;
+		}
+	    }
+	    memset(p, index & 0xFF, size);
+	    mm_unpin(handles[index]);
+	    trace->block_sizes[index] = size;
+	    live = live - oldsize + size;
+	    break;
+
+	case FREE: /* mm_hfree */
+	    mm_hfree(handles[index]);
+	    handles[index] = NULL;
+	    live -= trace->block_sizes[index];
+	    break;
+
+	case FREE_BATCH: /* one mm_hfree per block */
+	    for (j = index; j < index + trace->ops[i].count; j++) {
+		mm_hfree(handles[j]);
+		handles[j] = NULL;
+		live -= trace->block_sizes[j];
+	    }
+	    break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_handles");
 	}
+
+	if (live > max_live)
+	    max_live = live;
+	if ((i + 1) % compact_every == 0 &&
+	    !compact_pass(trace, handles, live, tracenum, i, hs))
+	    goto fail;
+    }
+
+    hs->valid = 1;
+    hs->util = (double)max_live / (double)mem_footprint();
+    if (hs->passes > 0) {
+	hs->util_before /= hs->passes;
+	hs->util_after /= hs->passes;
+    }
+ fail:
+    free(handles);
+    return hs->valid;
+}
+
+/*
+ * halloc_block - Allocate block index of size bytes through a handle
+ *     and fill it like eval_mm_valid does.
+ */
+static int halloc_block(trace_t *trace, mm_handle_t *handles, int index,
+			int size, int tracenum, int opnum)
+{
+    char *p;
+
+    if ((handles[index] = mm_halloc(size)) == NULL) {
+	malloc_error(tracenum, opnum, "mm_halloc failed.");
+	return 0;
+    }
+    p = mm_pin(handles[index]);
+    if (!IS_ALIGNED(p)) {
+	sprintf(msg, "Payload address (%p) not aligned to %d bytes",
+		p, ALIGNMENT);
+	malloc_error(tracenum, opnum, msg);
+	return 0;
     }
+    memset(p, index & 0xFF, size);
+    mm_unpin(handles[index]);
+    trace->block_sizes[index] = size;
+    return 1;
+}
+
+/*
+ * compact_pass - Run and time one mm_compact, record the heap in use
+ *     around it, and check that every live block kept its contents.
+ *     live is the number of payload bytes in live blocks.
+ */
+static int compact_pass(trace_t *trace, mm_handle_t *handles, size_t live,
+			int tracenum, int opnum, hstats_t *hs)
+{
+    int index, j, size;
+    unsigned char *p;
+
+    hs->passes++;
+    hs->util_before += (double)live / (double)mem_inuse();
+    hs->secs += fsecs_once(compact_funct, &hs->moved);
+    hs->util_after += (double)live / (double)mem_inuse();
+
+    for (index = 0; index < trace->num_ids; index++) {
+	if (handles[index] == NULL)
+	    continue;
+	size = trace->block_sizes[index];
+	p = mm_pin(handles[index]);
+	mm_unpin(handles[index]);
+	for (j = 0; j < size; j++) {
+	    if ((unsigned char)p[j] != (index & 0xFF)) {
+		malloc_error(tracenum, opnum, "mm_compact did not preserve "
+			     "the data of a block");
+		return 0;
+	    }
+	}
+    }
+    return 1;
+}
+
+/* compact_funct - mm_compact in the shape fsecs_once wants */
+static void compact_funct(void *argp)
+{
+    *(double *)argp += mm_compact();
+}
+
+/*
+ * free_batch - Free the count blocks in blocks[], with mm_free_batch if
+ *     the package has it and -B wasn't given, else one at a time.
+ */
+static void free_batch(char **blocks, int count)
+{
+    int j;
+
+    if (use_batch && mm_free_batch) {
+	mm_free_batch((void **)blocks, count);
+	return;
+    }
+    for (j = 0; j < count; j++)
+	mm_free(blocks[j]);
 }
 
 /*************************************
@@ -926,17 +1575,21 @@ static void printresults(int n, stats_t *stats)
     double util = 0;
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%8s%10s%6s%7s\n", 
+	   "trace", " valid", "util", "ops", "secs", "Kops", "sbrks");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
 		   (stats[i].ops/1e3)/stats[i].secs);
+	    if (stats[i].sbrks >= 0)
+		printf("%7d\n", stats[i].sbrks);
+	    else
+		printf("%7s\n", "-");
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
@@ -972,6 +1625,263 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * track_free_len - Record the length of the free lists after request
+ *     opnum of num_ops. Called by eval_mm_util, which isn't timed.
+ */
+static void track_free_len(int opnum, int num_ops)
+{
+    struct mm_search st;
+    long k = (long)(opnum + 1) * LEN_POINTS / num_ops;
+
+    mm_search_stats(&st);
+    len_sum += st.free_blocks;
+    if (st.free_blocks > len_max)
+	len_max = st.free_blocks;
+    if (k != (long)opnum * LEN_POINTS / num_ops)
+	len_at[k - 1] = st.free_blocks;
+}
+
+/*
+ * print_search_stats - Print how many free blocks and size classes the
+ *     searches of the last timed replay visited, as histograms, and the
+ *     free-list length over the util replay. Both count work rather than
+ *     time, so they compare fit strategies without timing noise.
+ */
+static void print_search_stats(int num_ops)
+{
+    struct mm_search st;
+    char label[32];
+    int i, last;
+
+    if (!mm_search_stats)
+	return;
+    mm_search_stats(&st);
+    printf("Free-list search: %lu searches, %.1f blocks and %.1f classes "
+	   "visited per search\n", (unsigned long)st.searches,
+	   st.searches ? (double)st.nodes / st.searches : 0.0,
+	   st.searches ? (double)st.buckets / st.searches : 0.0);
+    for (last = MM_SEARCH_BANDS - 1; last > 0; last--)
+	if (st.node_hist[last] != 0 || st.bucket_hist[last] != 0)
+	    break;
+    printf("  %-12s %10s %10s\n", "visited", "by blocks", "by classes");
+    for (i = 0; i <= last; i++) {
+	if (i <= 1)
+	    sprintf(label, "%d", i);
+	else if (i == MM_SEARCH_BANDS - 1)
+	    sprintf(label, ">=%lu", 1UL << (i - 1));
+	else
+	    sprintf(label, "%lu-%lu", 1UL << (i - 1), (1UL << i) - 1);
+	printf("  %-12s %10lu %10lu\n", label, (unsigned long)st.node_hist[i],
+	       (unsigned long)st.bucket_hist[i]);
+    }
+    printf("Free-list length: mean %.1f, max %lu; by tenths of the trace:",
+	   num_ops ? len_sum / num_ops : 0.0, (unsigned long)len_max);
+    for (i = 0; i < LEN_POINTS; i++)
+	printf(" %lu", (unsigned long)len_at[i]);
+    printf("\n");
+}
+
+/*
+ * print_heap_stats - Print what mm_stats reports about the heap left
+ *     behind by the last replay, if the package has it.
+ */
+static void print_heap_stats(void)
+{
+    struct mm_stats st;
+    int i;
+
+    if (!mm_stats)
+	return;
+    mm_stats(&st);
+    printf("Heap: %lu bytes in %lu sbrks, %lu mapped; %lu allocated, "
+	   "%lu deferred, %lu free in %lu blocks (by band:",
+	   (unsigned long)st.heap_bytes, (unsigned long)st.sbrk_calls,
+	   (unsigned long)st.mapped_bytes, (unsigned long)st.alloc_bytes,
+	   (unsigned long)st.deferred_bytes, (unsigned long)st.free_bytes,
+	   (unsigned long)st.free_blocks);
+    for (i = 0; i < MM_STAT_BANDS; i++)
+	printf(" %lu", (unsigned long)st.free_band[i]);
+    printf(")\n");
+}
+
+/*
+ * write_profile - Write the heap profile of the last timed replay of
+ *     trace tracenum to <prof_file>.<tracenum>.
+ */
+static void write_profile(int tracenum)
+{
+    char name[MAXLINE];
+    FILE *fp;
+
+    sprintf(name, "%s.%d", prof_file, tracenum);
+    if ((fp = fopen(name, "w")) == NULL)
+	unix_error("Could not open the heap profile");
+    if (mmprof_dump(fp) < 0 || fclose(fp) != 0)
+	unix_error("Could not write the heap profile");
+    if (verbose > 1)
+	printf("Wrote heap profile %s (%ld samples dropped)\n",
+	       name, mmprof_dropped());
+}
+
+/*
+ * printhresults - Print the handle replay results: peak utilization,
+ *     mean utilization of the heap in use before and after a pass,
+ *     number of passes, bytes moved and time spent compacting.
+ */
+static void printhresults(int n, hstats_t *hstats)
+{
+    int i;
+
+    printf("%5s%7s %5s%8s%8s%7s%10s%10s\n",
+	   "trace", " valid", "util", "before", "after", "passes",
+	   "moved KB", "secs");
+    for (i = 0; i < n; i++) {
+	if (hstats[i].valid)
+	    printf("%2d%10s%5.0f%%%7.0f%%%7.0f%%%7d%10.0f%10.6f\n",
+		   i,
+		   "yes",
+		   hstats[i].util*100.0,
+		   hstats[i].util_before*100.0,
+		   hstats[i].util_after*100.0,
+		   hstats[i].passes,
+		   hstats[i].moved/1024,
+		   hstats[i].secs);
+	else
+	    printf("%2d%10s%6s%8s%8s%7s%10s%10s\n",
+		   i, "no", "-", "-", "-", "-", "-", "-");
+    }
+}
+
+/*
+ * printbresults - Print the median run time of each trace in benchmark
+ *     mode, with the median absolute deviation and the bootstrap 95%
+ *     interval of the median.
+ */
+static void printbresults(int n, bstats_t *bstats)
+{
+    int i;
+
+    printf("%5s%12s%11s%25s\n", "trace", "median", "MAD", "95% CI of median");
+    for (i = 0; i < n; i++) {
+	if (bstats[i].n == 0) {
+	    printf("%2d%15s%11s%25s\n", i, "-", "-", "-");
+	    continue;
+	}
+	printf("%2d%15.6f%11.6f    [%.6f, %.6f]\n", i,
+	       bstats[i].sum.median, bstats[i].sum.mad,
+	       bstats[i].sum.lo, bstats[i].sum.hi);
+    }
+}
+
+/*
+ * save_bench - Write the run times of each trace to bench_save: a
+ *     line "# <host>" describing the host, then one line per trace
+ *     with the trace file, the number of runs and the times.
+ */
+static void save_bench(int n, bstats_t *bstats)
+{
+    FILE *fp;
+    int i, j;
+
+    if ((fp = fopen(bench_save, "w")) == NULL)
+	unix_error("Could not open the run time file");
+    fprintf(fp, "# %s\n", host);
+    for (i = 0; i < n; i++) {
+	if (bstats[i].n == 0)
+	    continue;
+	fprintf(fp, "%s %d", bstats[i].name, bstats[i].n);
+	for (j = 0; j < bstats[i].n; j++)
+	    fprintf(fp, " %.9g", bstats[i].secs[j]);
+	fprintf(fp, "\n");
+    }
+    if (fclose(fp) != 0)
+	unix_error("Could not write the run time file");
+    printf("Wrote run times to %s\n", bench_save);
+}
+
+/*
+ * compare_bench - Compare the run times of each trace with those saved
+ *     in bench_base by an earlier run, e.g. of another package. A change
+ *     is significant if the Mann-Whitney test rejects "no difference"
+ *     after Holm's correction for the number of traces compared, so
+ *     the chance of flagging any unchanged trace stays within
+ *     BENCH_ALPHA. Says so if the host was set up differently.
+ */
+static void compare_bench(int n, bstats_t *bstats)
+{
+    FILE *fp;
+    char name[MAXLINE], base_host[HOSTENV_LINE];
+    double *base, *p;
+    int i, j, m, nbase, *found, *reject;
+    long start;
+    bench_compare_t *c;
+
+    if ((fp = fopen(bench_base, "r")) == NULL)
+	unix_error("Could not open the baseline run time file");
+    if (fscanf(fp, "# %255[^\n]", base_host) != 1) /* HOSTENV_LINE - 1 */
+	strcpy(base_host, "not recorded");
+    fscanf(fp, "%*[^\n]"); /* the rest of an overlong host line */
+    start = ftell(fp);
+    if ((c = malloc(n * sizeof(bench_compare_t))) == NULL ||
+	(found = calloc(n, sizeof(int))) == NULL ||
+	(p = malloc(n * sizeof(double))) == NULL ||
+	(reject = malloc(n * sizeof(int))) == NULL)
+	unix_error("malloc in compare_bench failed");
+
+    /* Compare each trace found in the file */
+    m = 0;
+    for (i = 0; i < n; i++) {
+	if (bstats[i].n == 0)
+	    continue;
+	fseek(fp, start, SEEK_SET);
+	base = NULL;
+	while (fscanf(fp, "%1023s %d", name, &nbase) == 2 && nbase > 0) {
+	    if ((base = malloc(nbase * sizeof(double))) == NULL)
+		unix_error("malloc of baseline samples failed");
+	    for (j = 0; j < nbase; j++)
+		if (fscanf(fp, "%lf", &base[j]) != 1)
+		    app_error("Malformed baseline run time file");
+	    if (strcmp(name, bstats[i].name) == 0)
+		break;
+	    free(base);
+	    base = NULL;
+	}
+	if (base == NULL)
+	    continue;
+	bench_compare(base, nbase, bstats[i].secs, bstats[i].n, &c[i]);
+	found[i] = 1;
+	p[m++] = c[i].p;
+	free(base);
+    }
+    fclose(fp);
+    bench_holm(p, m, BENCH_ALPHA, reject);
+
+    printf("Compared %d traces with %s (change of the median run time,\n"
+	   "significant at %g after Holm's correction):\n",
+	   m, bench_base, BENCH_ALPHA);
+    if (strcmp(base_host, host) != 0)
+	printf("WARNING: The baseline host differs: %s\n", base_host);
+    printf("%5s%12s%12s%11s%21s%9s\n",
+	   "trace", "base", "this", "change", "95% CI", "p");
+    for (i = 0, j = 0; i < n; i++) {
+	if (bstats[i].n == 0)
+	    continue;
+	if (!found[i]) {
+	    printf("%2d  not in the baseline\n", i);
+	    continue;
+	}
+	printf("%2d%15.6f%12.6f%+9.1f%%  [%+7.1f%%, %+7.1f%%]%9.4f %s\n", i,
+	       c[i].median_a, c[i].median_b, c[i].change * 100,
+	       c[i].lo * 100, c[i].hi * 100, c[i].p,
+	       reject[j++] ? "significant" : "");
+    }
+    free(c);
+    free(found);
+    free(p);
+    free(reject);
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -1004,14 +1914,29 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValBSp] [-f <file>] [-t <dir>] [-H <n>]\n"
+	    "               [-P <file> [-r <bytes>]] [-T <timer>] [-M cold|warm]\n"
+	    "               [-C <cpu>] [-R <n> [-w <n>] [-o <file>] [-c <file>]]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-B         Replay batch requests one block at a time.\n");
+    fprintf(stderr, "\t-S         Free with mm_free_sized, passing the trace size.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-H <n>     Also replay through handles, compacting every <n> requests.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-P <file>  Write heap profiles of the timed replays to <file>.<n>.\n");
+    fprintf(stderr, "\t-r <bytes> Sample one allocation every <bytes> on average for -P.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-T <timer> Time with monotonic, tsc, gettod, itimer or fcyc.\n");
+    fprintf(stderr, "\t-C <cpu>   Pin to CPU <cpu>, or to the one mdriver starts on if -1.\n");
+    fprintf(stderr, "\t-p         Raise the scheduling priority (needs CAP_SYS_NICE).\n");
+    fprintf(stderr, "\t-M <mode>  Time with a cold (cleared) or warm (default) cache.\n");
+    fprintf(stderr, "\t-R <n>     Time <n> replays of each trace one by one (benchmark mode).\n");
+    fprintf(stderr, "\t-w <n>     Replay each trace <n> times untimed before that (default 2).\n");
+    fprintf(stderr, "\t-o <file>  Save the run times of -R to <file>.\n");
+    fprintf(stderr, "\t-c <file>  Compare the run times of -R with those saved in <file>.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
 }
@@ -2,7 +2,17 @@
  * memlib.c - a module that simulates the memory system.  Needed because it 
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
+ *
+ *            The model is a set of regions, each with its own simulated
+ *            brk. The original mem_* functions operate on the default
+ *            region created by mem_init; packages that want independent
+ *            heaps (arenas, slabs, ...) create more with mem_region_create.
+ *
+ *            Besides the regions, the model hands out dedicated mappings
+ *            (mem_map/mem_remap/mem_unmap) for large blocks, so that they
+ *            can be resized by the kernel without copying.
  */
+#define _GNU_SOURCE  /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,24 +24,75 @@
 #include "memlib.h"
 #include "config.h"
 
+/*
+ * Built with MEM_PRELOAD, the model is the real heap of the process
+ * (see mmpreload.c): malloc is then the package itself, so the model's
+ * own records come from the C library's allocator, and trimmed pages
+ * are given back to the kernel.
+ */
+#ifdef MEM_PRELOAD
+extern void *__libc_malloc(size_t size);
+extern void __libc_free(void *ptr);
+#define malloc(size) __libc_malloc(size)
+#define free(ptr) __libc_free(ptr)
+#endif
+
+/* One simulated heap with its own brk */
+struct mem_region {
+    char *start_brk;             /* points to first byte of the region */
+    char *brk;                   /* points to last byte of the region */
+    char *max_addr;              /* largest legal address in the region */
+    char *dirty;                 /* bytes below this may have been written */
+    struct mem_region *next;     /* next live region */
+};
+
+/* Records one dedicated mapping handed out by mem_map */
+typedef struct map_t {
+    char *addr;              /* first byte of the mapping */
+    size_t size;             /* length of the mapping in bytes */
+    struct map_t *next;      /* next list element */
+} map_t;
+
 /* private variables */
-static char *mem_start_brk;  /* points to first byte of heap */
-static char *mem_brk;        /* points to last byte of heap */
-static char *mem_max_addr;   /* largest legal heap address */ 
+static mem_region_t *mem_default;  /* the region behind mem_sbrk & co. */
+static mem_region_t *mem_regions;  /* all live regions, default included */
+static size_t mem_region_bytes;    /* total bytes below the brk of all regions */
+static size_t mem_sbrks;           /* successful mem_sbrk/mem_region_sbrk calls */
+
+static map_t *mem_maps;      /* live dedicated mappings */
+static size_t mem_map_bytes; /* total bytes in live mappings */
+static size_t mem_peak;      /* high water mark of region + mapped bytes */
+static size_t mem_max_heap;  /* budget of region + mapped bytes */
+
+static void mem_update_peak(void);
 
 /* 
  * mem_init - initialize the memory system model
  */
 void mem_init(void)
 {
+    mem_init_max(MAX_HEAP);
+}
+
+/*
+ * mem_init_max - initialize the model with a budget of max_heap bytes
+ *    instead of MAX_HEAP
+ */
+void mem_init_max(size_t max_heap)
+{
+    mem_regions = NULL;
+    mem_region_bytes = 0;
+    mem_sbrks = 0;
+    mem_maps = NULL;
+    mem_map_bytes = 0;
+    mem_peak = 0;
+    mem_max_heap = max_heap;
+
     /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
-	fprintf(stderr, "mem_init_vm: malloc error\n");
+    if ((mem_default = mem_region_create(max_heap)) == NULL) {
+	fprintf(stderr, "mem_init_vm: mmap error\n");
 	exit(1);
     }
-
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-    mem_brk = mem_start_brk;                  /* heap is empty initially */
 }
 
 /* 
@@ -39,33 +100,70 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    mem_reset_brk();
+    mem_region_destroy(mem_default);
+    mem_default = NULL;
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *    releasing any mappings and extra regions the previous run left
+ *    behind. Packages that use extra regions create them in mm_init.
  */
 void mem_reset_brk()
 {
-    mem_brk = mem_start_brk;
+    mem_region_t *r, *rnext;
+    map_t *m, *mnext;
+
+    for (r = mem_regions; r != NULL; r = rnext) {
+	rnext = r->next;
+	if (r != mem_default)
+	    mem_region_destroy(r);
+    }
+    for (m = mem_maps; m != NULL; m = mnext) {
+	mnext = m->next;
+	munmap(m->addr, m->size);
+	free(m);
+    }
+    mem_maps = NULL;
+    mem_map_bytes = 0;
+    mem_region_reset(mem_default);
+    mem_peak = 0;
+    mem_sbrks = 0;
+}
+
+/*
+ * mem_zero_brk - zero the bytes above the brk that earlier runs wrote,
+ *    which mem_sbrk would otherwise zero as it hands them out again.
+ *    Lets a caller do that work up front, outside a timed run.
+ */
+void mem_zero_brk(void)
+{
+    mem_region_t *r = mem_default;
+
+    if (r->brk < r->dirty)
+	memset(r->brk, 0, r->dirty - r->brk);
+    r->dirty = r->brk;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area, which
+ *    reads as zero. In this model, the heap cannot be shrunk by
+ *    mem_sbrk; use mem_trim.
  */
 void *mem_sbrk(int incr) 
 {
-    char *old_brk = mem_brk;
+    return mem_region_sbrk(mem_default, incr);
+}
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
-	errno = ENOMEM;
-	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
-	return (void *)-1;
-    }
-    mem_brk += incr;
-    return (void *)old_brk;
+/*
+ * mem_trim - give the top decr bytes of the heap back. Returns 0, or
+ *    -1 if the heap is smaller than decr.
+ */
+int mem_trim(size_t decr)
+{
+    return mem_region_trim(mem_default, decr);
 }
 
 /*
@@ -73,7 +171,7 @@ void *mem_sbrk(int incr)
  */
 void *mem_heap_lo()
 {
-    return (void *)mem_start_brk;
+    return mem_region_lo(mem_default);
 }
 
 /* 
@@ -81,7 +179,7 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    return mem_region_hi(mem_default);
 }
 
 /*
@@ -89,7 +187,16 @@ void *mem_heap_hi()
  */
 size_t mem_heapsize() 
 {
-    return (size_t)(mem_brk - mem_start_brk);
+    return mem_region_size(mem_default);
+}
+
+/*
+ * mem_sbrkcount() - returns the number of successful sbrk calls, in
+ *    any region, since the last mem_reset_brk
+ */
+size_t mem_sbrkcount()
+{
+    return mem_sbrks;
 }
 
 /*
@@ -99,3 +206,289 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_region_create - reserve a new, empty region that can grow to at
+ *    most max_size bytes. Returns NULL if the space can't be reserved.
+ */
+mem_region_t *mem_region_create(size_t max_size)
+{
+    mem_region_t *r;
+    char *start;
+
+    start = mmap(NULL, max_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (start == MAP_FAILED)
+	return NULL;
+    if ((r = (mem_region_t *)malloc(sizeof(mem_region_t))) == NULL) {
+	munmap(start, max_size);
+	return NULL;
+    }
+    r->start_brk = start;
+    r->brk = start;                 /* region is empty initially */
+    r->dirty = start;               /* and reads as zero */
+    r->max_addr = start + max_size; /* max legal region address */
+    r->next = mem_regions;
+    mem_regions = r;
+    return r;
+}
+
+/*
+ * mem_region_destroy - release a region and everything allocated in it
+ */
+void mem_region_destroy(mem_region_t *r)
+{
+    mem_region_t *p;
+    mem_region_t **prevpp = &mem_regions;
+
+    for (p = mem_regions; p != NULL; p = p->next) {
+	if (p == r) {
+	    *prevpp = p->next;
+	    break;
+	}
+	prevpp = &(p->next);
+    }
+    mem_region_bytes -= (size_t)(r->brk - r->start_brk);
+    munmap(r->start_brk, (size_t)(r->max_addr - r->start_brk));
+    free(r);
+}
+
+/*
+ * mem_region_reset - reset the brk of region r to make it empty
+ */
+void mem_region_reset(mem_region_t *r)
+{
+    mem_region_bytes -= (size_t)(r->brk - r->start_brk);
+    r->brk = r->start_brk;
+}
+
+/*
+ * mem_region_sbrk - mem_sbrk for region r. Extends the region by incr
+ *    bytes and returns the start address of the new, zeroed area.
+ *    Regions cannot be shrunk, and all of them together with the mappings
+ *    share the budget set by mem_init.
+ */
+void *mem_region_sbrk(mem_region_t *r, int incr)
+{
+    char *old_brk = r->brk;
+
+    if ( (incr < 0) || ((r->brk + incr) > r->max_addr) ||
+	 (mem_region_bytes + mem_map_bytes + incr > mem_max_heap)) {
+	errno = ENOMEM;
+	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+    /* Like the kernel, hand out zeroed memory, even after a reset */
+    if (old_brk < r->dirty)
+	memset(old_brk, 0, (r->brk + incr < r->dirty ? r->brk + incr : r->dirty) - old_brk);
+    mem_sbrks++;
+    r->brk += incr;
+    if (r->brk > r->dirty)
+	r->dirty = r->brk;
+    mem_region_bytes += incr;
+    mem_update_peak();
+    return (void *)old_brk;
+}
+
+/*
+ * mem_region_trim - lower the brk of region r by decr bytes. Returns 0,
+ *    or -1 if the region is smaller than decr. The peak reported by
+ *    mem_footprint is not lowered. With MEM_PRELOAD, the whole pages
+ *    above the new brk go back to the kernel.
+ */
+int mem_region_trim(mem_region_t *r, size_t decr)
+{
+    if (decr > (size_t)(r->brk - r->start_brk)) {
+	errno = EINVAL;
+	return -1;
+    }
+    r->brk -= decr;
+    mem_region_bytes -= decr;
+#ifdef MEM_PRELOAD
+    {
+	size_t pagesize = mem_pagesize();
+	char *lo = (char *)(((unsigned long)r->brk + pagesize - 1) & ~(pagesize - 1));
+
+	if (lo < r->dirty && madvise(lo, r->dirty - lo, MADV_DONTNEED) == 0)
+	    r->dirty = lo;  /* the pages read as zero again */
+    }
+#endif
+    return 0;
+}
+
+/*
+ * mem_region_lo - return address of the first byte of region r
+ */
+void *mem_region_lo(mem_region_t *r)
+{
+    return (void *)r->start_brk;
+}
+
+/*
+ * mem_region_hi - return address of the last byte of region r
+ */
+void *mem_region_hi(mem_region_t *r)
+{
+    return (void *)(r->brk - 1);
+}
+
+/*
+ * mem_region_size - returns the size of region r in bytes
+ */
+size_t mem_region_size(mem_region_t *r)
+{
+    return (size_t)(r->brk - r->start_brk);
+}
+
+/*
+ * mem_map - give the caller a dedicated, page-aligned mapping of size
+ *    bytes (size must be a multiple of the page size). Returns
+ *    (void *)-1 like mem_sbrk when the model runs out of memory.
+ */
+void *mem_map(size_t size)
+{
+    map_t *m;
+    char *addr;
+
+    if (mem_region_bytes + mem_map_bytes + size > mem_max_heap) {
+	errno = ENOMEM;
+	fprintf(stderr, "ERROR: mem_map failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+	return (void *)-1;
+    if ((m = (map_t *)malloc(sizeof(map_t))) == NULL) {
+	munmap(addr, size);
+	return (void *)-1;
+    }
+    m->addr = addr;
+    m->size = size;
+    m->next = mem_maps;
+    mem_maps = m;
+    mem_map_bytes += size;
+    mem_update_peak();
+    return (void *)addr;
+}
+
+/*
+ * mem_remap - grow or shrink a mapping returned by mem_map to new_size
+ *    bytes. The kernel moves the page tables if the mapping cannot be
+ *    resized in place, so the contents are never copied. Returns the
+ *    (possibly new) address, or (void *)-1 on failure, in which case the
+ *    old mapping is left untouched.
+ */
+void *mem_remap(void *addr, size_t new_size)
+{
+    map_t *m;
+    char *new_addr;
+
+    for (m = mem_maps; m != NULL; m = m->next)
+	if (m->addr == (char *)addr)
+	    break;
+    if (m == NULL)
+	return (void *)-1;
+    if (new_size > m->size &&
+	mem_region_bytes + mem_map_bytes + (new_size - m->size) > mem_max_heap) {
+	errno = ENOMEM;
+	fprintf(stderr, "ERROR: mem_remap failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+    new_addr = mremap(m->addr, m->size, new_size, MREMAP_MAYMOVE);
+    if (new_addr == MAP_FAILED)
+	return (void *)-1;
+    mem_map_bytes = mem_map_bytes - m->size + new_size;
+    m->addr = new_addr;
+    m->size = new_size;
+    mem_update_peak();
+    return (void *)new_addr;
+}
+
+/*
+ * mem_unmap - release a mapping returned by mem_map or mem_remap
+ */
+void mem_unmap(void *addr)
+{
+    map_t *m;
+    map_t **prevpp = &mem_maps;
+
+    for (m = mem_maps; m != NULL; m = m->next) {
+	if (m->addr == (char *)addr) {
+	    *prevpp = m->next;
+	    munmap(m->addr, m->size);
+	    mem_map_bytes -= m->size;
+	    free(m);
+	    return;
+	}
+	prevpp = &(m->next);
+    }
+}
+
+/*
+ * mem_in_map - return true if the bytes lo..hi all lie inside one
+ *    live mapping
+ */
+int mem_in_map(void *lo, void *hi)
+{
+    map_t *m;
+
+    for (m = mem_maps; m != NULL; m = m->next)
+	if ((char *)lo >= m->addr && (char *)hi < m->addr + m->size)
+	    return 1;
+    return 0;
+}
+
+/*
+ * mem_in_region - return true if the bytes lo..hi all lie below the brk
+ *    of one live region
+ */
+int mem_in_region(void *lo, void *hi)
+{
+    mem_region_t *r;
+
+    for (r = mem_regions; r != NULL; r = r->next)
+	if ((char *)lo >= r->start_brk && (char *)hi < r->brk)
+	    return 1;
+    return 0;
+}
+
+/*
+ * mem_mapsize - returns the number of bytes in live mappings
+ */
+size_t mem_mapsize()
+{
+    return mem_map_bytes;
+}
+
+/*
+ * mem_footprint - returns the high water mark of region plus mapped
+ *    bytes since the last mem_reset_brk. It stays at the peak when
+ *    mem_trim or mem_region_trim lower the brk afterwards, so it can
+ *    exceed mem_heapsize() even when only the default region was used.
+ */
+size_t mem_footprint()
+{
+    return mem_peak;
+}
+
+/*
+ * mem_inuse - returns the region plus mapped bytes right now, which can
+ *    be below mem_footprint once regions were trimmed or mappings
+ *    released
+ */
+size_t mem_inuse()
+{
+    return mem_region_bytes + mem_map_bytes;
+}
+
+/*
+ * mem_update_peak - fold the current footprint into the high water mark
+ */
+static void mem_update_peak(void)
+{
+    size_t cur = mem_region_bytes + mem_map_bytes;
+
+    if (cur > mem_peak)
+	mem_peak = cur;
+}
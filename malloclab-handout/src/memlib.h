@@ -1,11 +1,37 @@
 #include <unistd.h>
 
 void mem_init(void);               
+void mem_init_max(size_t max_heap);
 void mem_deinit(void);
 void *mem_sbrk(int incr);
+int mem_trim(size_t decr);
 void mem_reset_brk(void); 
+void mem_zero_brk(void);
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
+size_t mem_sbrkcount(void);
 size_t mem_pagesize(void);
 
+/* Independent simulated heaps, each with its own brk */
+typedef struct mem_region mem_region_t;
+
+mem_region_t *mem_region_create(size_t max_size);
+void mem_region_destroy(mem_region_t *r);
+void mem_region_reset(mem_region_t *r);
+void *mem_region_sbrk(mem_region_t *r, int incr);
+int mem_region_trim(mem_region_t *r, size_t decr);
+void *mem_region_lo(mem_region_t *r);
+void *mem_region_hi(mem_region_t *r);
+size_t mem_region_size(mem_region_t *r);
+int mem_in_region(void *lo, void *hi);
+
+/* Dedicated mappings for large blocks */
+void *mem_map(size_t size);
+void *mem_remap(void *addr, size_t new_size);
+void mem_unmap(void *addr);
+int mem_in_map(void *lo, void *hi);
+size_t mem_mapsize(void);
+size_t mem_footprint(void);
+size_t mem_inuse(void);
+
@@ -0,0 +1,480 @@
+/*
+ * mm-compact.c - A compacting malloc package with movable blocks.
+ *
+ * Besides the usual mm_malloc interface, this package hands out blocks
+ * through handles (mm_halloc). A handle names a block whose address may
+ * change: the caller pins it with mm_pin to get the payload address and
+ * unpins it with mm_unpin when done. mm_compact slides every unpinned
+ * handle block towards the bottom of the heap, squeezing out the free
+ * space between them, and gives the free space left at the top back
+ * with mem_trim. Blocks from mm_malloc and pinned handle blocks never
+ * move; compaction fills the space below them and leaves a hole above.
+ *
+ * Blocks use boundary tags, and a second header word holds the index of
+ * the handle that owns the block, so that compaction can update it:
+ *
+ *     | size|a | handle | payload ...          | size|a |
+ *                       ^bp
+ *
+ * Free blocks are coalesced immediately and found by next fit over the
+ * implicit list. The handle table lives in a memlib region of its own,
+ * so handles keep their address while the table grows; unused entries
+ * are chained through their offset field.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "mm.h"
+#include "memlib.h"
+
+/*********************************************************
+ * NOTE TO STUDENTS: Before you do anything else, please
+ * provide your team information in the following struct.
+ ********************************************************/
+team_t team = {
+    /* Team name */
+    "None",
+    /* First member's full name */
+    "None",
+    /* First member's email address */
+    "None",
+    /* Second member's full name (leave blank if none) */
+    "",
+    /* Second member's email address (leave blank if none) */
+    ""};
+
+/* single word (4) or double word (8) alignment */
+#define ALIGNMENT 8
+
+/* rounds up to the nearest multiple of ALIGNMENT */
+#define ALIGN(size) (((size) + (ALIGNMENT - 1)) & ~0x7)
+
+/* Basic constants and macros */
+#define WSIZE 4         /* Word and header/footer size (bytes) */
+#define DSIZE 8         /* Double word size (bytes) */
+#define OVERHEAD 12     /* Header, handle index and footer */
+#define MIN_BLOCK 16    /* Smallest block, with 4 bytes of payload */
+#define CHUNKSIZE (1 << 12) /* Extend heap by at least this amount (bytes) */
+
+#define HCHUNK 512          /* Handles added to the table at a time */
+#define HTAB_MAX (16 << 20) /* Address space reserved for the handle table */
+#define NO_HANDLE 0xffffffffu /* Handle index of mm_malloc blocks */
+
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+
+/* Pack a size and allocated bit into a word */
+#define PACK(size, alloc) ((size) | (alloc))
+
+/* Read and write a word at address p */
+#define GET(p) (*(unsigned int *)(p))
+#define PUT(p, val) (*(unsigned int *)(p) = (val))
+
+/* Read the size and allocated fields from address p */
+#define GET_SIZE(p) (GET(p) & ~0x7)
+#define GET_ALLOC(p) (GET(p) & 0x1)
+
+/* Given block ptr bp, compute address of its header, handle index and footer */
+#define HDRP(bp) ((char *)(bp) - DSIZE)
+#define HIDP(bp) ((char *)(bp) - WSIZE)
+#define FTRP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)) - OVERHEAD)
+
+/* Given block ptr bp, compute address of next and previous blocks */
+#define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(HDRP(bp)))
+#define PREV_BLKP(bp) ((char *)(bp) - GET_SIZE((char *)(bp) - OVERHEAD))
+
+/* One handle table entry */
+struct mm_handle {
+    unsigned int off;  /* Payload offset from heap_lo; next unused entry when unused */
+    unsigned int pins; /* Outstanding mm_pin calls */
+};
+
+static void *extend_heap(size_t size);
+static size_t adjust_size(size_t size);
+static void *alloc_block(size_t size, unsigned int hid);
+static void *find_fit(size_t asize);
+static void place(void *bp, size_t asize, unsigned int hid);
+static void *coalesce(void *bp);
+static int grow_block(char *bp, size_t asize);
+static unsigned int new_handle(void);
+
+static char *heap_lo;    /* First byte of the heap */
+static char *heap_listp; /* First block */
+static char *rover;      /* Where the next fit search starts */
+
+static mem_region_t *hregion;  /* Region holding the handle table */
+static struct mm_handle *htab; /* The handle table */
+static unsigned int hcount;    /* Entries in htab */
+static unsigned int hfree;     /* First unused entry, or NO_HANDLE */
+
+static unsigned long compactions; /* Calls to mm_compact */
+static size_t moved_bytes;        /* Bytes moved by all of them */
+
+/*
+ * mm_init - initialize the malloc package.
+ */
+int mm_init(void)
+{
+    /* Create the initial empty heap */
+    if ((heap_lo = mem_sbrk(2 * DSIZE)) == (void *)-1)
+        return -1;
+    PUT(heap_lo, 0);                          /* Alignment padding */
+    PUT(heap_lo + (1 * WSIZE), PACK(0, 1));   /* Prologue footer */
+    PUT(heap_lo + (2 * WSIZE), PACK(0, 1));   /* Epilogue header */
+    PUT(heap_lo + (3 * WSIZE), NO_HANDLE);
+    heap_listp = heap_lo + 2 * DSIZE;
+    rover = heap_listp;
+
+    /* mem_reset_brk dropped the previous table with its region */
+    if ((hregion = mem_region_create(HTAB_MAX)) == NULL)
+        return -1;
+    htab = mem_region_lo(hregion);
+    hcount = 0;
+    hfree = NO_HANDLE;
+
+    compactions = 0;
+    moved_bytes = 0;
+    return 0;
+}
+
+/*
+ * extend_heap - Grow the heap by size bytes. The old epilogue becomes
+ *     the header of the new free block.
+ */
+static void *extend_heap(size_t size)
+{
+    char *bp;
+
+    if ((long)(bp = mem_sbrk(size)) == -1)
+        return NULL;
+    PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
+    PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
+    PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+    return coalesce(bp);
+}
+
+static size_t adjust_size(size_t size)
+{
+    return MAX(ALIGN(size + OVERHEAD), MIN_BLOCK);
+}
+
+/*
+ * alloc_block - Allocate a block for size bytes of payload, owned by
+ *     handle hid.
+ */
+static void *alloc_block(size_t size, unsigned int hid)
+{
+    size_t asize = adjust_size(size);
+    char *bp;
+
+    if ((bp = find_fit(asize)) == NULL &&
+        (bp = extend_heap(MAX(asize, CHUNKSIZE))) == NULL)
+        return NULL;
+    place(bp, asize, hid);
+    return bp;
+}
+
+static void *find_fit(size_t asize)
+{
+    char *bp;
+
+    for (bp = rover; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+        if (!GET_ALLOC(HDRP(bp)) && asize <= GET_SIZE(HDRP(bp)))
+            return rover = bp;
+    for (bp = heap_listp; bp < rover; bp = NEXT_BLKP(bp))
+        if (!GET_ALLOC(HDRP(bp)) && asize <= GET_SIZE(HDRP(bp)))
+            return rover = bp;
+    return NULL; /* No fit */
+}
+
+static void place(void *bp, size_t asize, unsigned int hid)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if ((size - asize) >= MIN_BLOCK)
+    {
+        PUT(HDRP(bp), PACK(asize, 1));
+        PUT(FTRP(bp), PACK(asize, 1));
+        PUT(HDRP(NEXT_BLKP(bp)), PACK(size - asize, 0));
+        PUT(FTRP(NEXT_BLKP(bp)), PACK(size - asize, 0));
+    }
+    else
+    {
+        PUT(HDRP(bp), PACK(size, 1));
+        PUT(FTRP(bp), PACK(size, 1));
+    }
+    PUT(HIDP(bp), hid);
+}
+
+static void *coalesce(void *bp)
+{
+    size_t prev_alloc = GET_ALLOC((char *)bp - OVERHEAD);
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (prev_alloc && next_alloc)
+    { /* Case 1 */
+        return bp;
+    }
+
+    if (prev_alloc && !next_alloc)
+    { /* Case 2 */
+        size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
+        PUT(HDRP(bp), PACK(size, 0));
+        PUT(FTRP(bp), PACK(size, 0));
+    }
+    else if (!prev_alloc && next_alloc)
+    { /* Case 3 */
+        size += GET_SIZE(HDRP(PREV_BLKP(bp)));
+        PUT(FTRP(bp), PACK(size, 0));
+        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+        bp = PREV_BLKP(bp);
+    }
+    else
+    { /* Case 4 */
+        size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
+                GET_SIZE(HDRP(NEXT_BLKP(bp)));
+        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
+        PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
+        bp = PREV_BLKP(bp);
+    }
+
+    /* The rover must not point into the middle of the merged block */
+    if (rover > (char *)bp && rover < NEXT_BLKP(bp))
+        rover = bp;
+    return bp;
+}
+
+/*
+ * grow_block - Resize the allocated block bp to asize bytes without
+ *     moving it, absorbing the next block if it is free (or extending
+ *     the heap if bp is the last block). Returns 0 if it can't.
+ */
+static int grow_block(char *bp, size_t asize)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *next = NEXT_BLKP(bp);
+
+    if (asize <= size)
+        return 1;
+    if (GET_SIZE(HDRP(next)) == 0 &&
+        extend_heap(MAX(asize - size, CHUNKSIZE)) == NULL)
+        return 0;
+    if (GET_ALLOC(HDRP(next)) || size + GET_SIZE(HDRP(next)) < asize)
+        return 0;
+
+    size += GET_SIZE(HDRP(next));
+    if (rover == next)
+        rover = bp;
+    PUT(HDRP(bp), PACK(size, 1));
+    PUT(FTRP(bp), PACK(size, 1));
+    place(bp, asize, GET(HIDP(bp)));
+    return 1;
+}
+
+/*
+ * mm_malloc - Allocate a block that never moves.
+ */
+void *mm_malloc(size_t size)
+{
+    /* Ignore spurious requests */
+    if (size == 0)
+        return NULL;
+    return alloc_block(size, NO_HANDLE);
+}
+
+/*
+ * mm_free - Free a block and coalesce it with its free neighbors.
+ */
+void mm_free(void *bp)
+{
+    size_t size;
+
+    if (bp == NULL)
+        return;
+    size = GET_SIZE(HDRP(bp));
+    PUT(HDRP(bp), PACK(size, 0));
+    PUT(FTRP(bp), PACK(size, 0));
+    coalesce(bp);
+}
+
+/*
+ * mm_realloc - Grow in place if the next block allows it, else move.
+ */
+void *mm_realloc(void *ptr, size_t size)
+{
+    char *newptr;
+
+    if (ptr == NULL)
+        return mm_malloc(size);
+    if (size == 0)
+    {
+        mm_free(ptr);
+        return NULL;
+    }
+    if (grow_block(ptr, adjust_size(size)))
+        return ptr;
+    if ((newptr = alloc_block(size, GET(HIDP(ptr)))) == NULL)
+        return NULL;
+    memcpy(newptr, ptr, MIN(size, GET_SIZE(HDRP(ptr)) - OVERHEAD));
+    mm_free(ptr);
+    return newptr;
+}
+
+/*
+ * new_handle - Take an unused handle table entry, growing the table by
+ *     HCHUNK entries when there is none. Returns its index or NO_HANDLE.
+ */
+static unsigned int new_handle(void)
+{
+    unsigned int h;
+
+    if (hfree == NO_HANDLE)
+    {
+        if ((long)mem_region_sbrk(hregion, HCHUNK * sizeof(struct mm_handle)) == -1)
+            return NO_HANDLE;
+        for (h = hcount + HCHUNK; h-- > hcount;)
+        {
+            htab[h].off = hfree;
+            hfree = h;
+        }
+        hcount += HCHUNK;
+    }
+    h = hfree;
+    hfree = htab[h].off;
+    htab[h].pins = 0;
+    return h;
+}
+
+/*
+ * mm_halloc - Allocate a movable block of size bytes and return its
+ *     handle, or NULL.
+ */
+mm_handle_t mm_halloc(size_t size)
+{
+    unsigned int h;
+    char *bp;
+
+    if (size == 0 || (h = new_handle()) == NO_HANDLE)
+        return NULL;
+    if ((bp = alloc_block(size, h)) == NULL)
+    {
+        htab[h].off = hfree;
+        hfree = h;
+        return NULL;
+    }
+    htab[h].off = bp - heap_lo;
+    return &htab[h];
+}
+
+/*
+ * mm_hrealloc - Resize the block of handle h to size bytes. A pinned
+ *     block can only grow in place. Returns 0, or -1 on failure, in
+ *     which case the block is left untouched.
+ */
+int mm_hrealloc(mm_handle_t h, size_t size)
+{
+    char *bp = heap_lo + h->off;
+    char *newbp;
+
+    if (grow_block(bp, adjust_size(size)))
+        return 0;
+    if (h->pins != 0)
+        return -1;
+    if ((newbp = alloc_block(size, h - htab)) == NULL)
+        return -1;
+    memcpy(newbp, bp, GET_SIZE(HDRP(bp)) - OVERHEAD);
+    mm_free(bp);
+    h->off = newbp - heap_lo;
+    return 0;
+}
+
+/*
+ * mm_hfree - Free the block of handle h. The handle becomes invalid.
+ */
+void mm_hfree(mm_handle_t h)
+{
+    mm_free(heap_lo + h->off);
+    h->off = hfree;
+    hfree = h - htab;
+}
+
+/*
+ * mm_pin - Return the payload address of handle h. The block won't
+ *     move until a matching mm_unpin.
+ */
+void *mm_pin(mm_handle_t h)
+{
+    h->pins++;
+    return heap_lo + h->off;
+}
+
+void mm_unpin(mm_handle_t h)
+{
+    h->pins--;
+}
+
+/*
+ * mm_compact - Slide the unpinned handle blocks down over the free
+ *     space, in address order, and trim the heap above the last block
+ *     that is still in use. Returns the number of bytes moved.
+ */
+size_t mm_compact(void)
+{
+    char *bp, *next;
+    char *dst = heap_listp; /* Where the next movable block goes */
+    size_t size, moved = 0;
+    unsigned int h;
+
+    for (bp = heap_listp; (size = GET_SIZE(HDRP(bp))) > 0; bp = next)
+    {
+        next = bp + size;
+        if (!GET_ALLOC(HDRP(bp)))
+            continue;
+        h = GET(HIDP(bp));
+        if (h != NO_HANDLE && htab[h].pins == 0)
+        {
+            if (dst != bp)
+            {
+                memmove(HDRP(dst), HDRP(bp), size);
+                htab[h].off = dst - heap_lo;
+                moved += size;
+            }
+            dst += size;
+        }
+        else
+        {
+            /* Blocks that can't move leave the space below them free */
+            if (dst != bp)
+            {
+                PUT(HDRP(dst), PACK(bp - dst, 0));
+                PUT(FTRP(dst), PACK(bp - dst, 0));
+            }
+            dst = next;
+        }
+    }
+
+    /* Everything from dst up is free: bp is past the epilogue */
+    if (dst != bp)
+    {
+        PUT(HDRP(dst), PACK(0, 1));
+        mem_trim(bp - dst);
+    }
+    rover = heap_listp;
+
+    compactions++;
+    moved_bytes += moved;
+    return moved;
+}
+
+/*
+ * mm_print_stats - Report what compaction did on this run.
+ */
+void mm_print_stats(void)
+{
+    printf("Compaction: %lu passes moved %lu bytes\n",
+           compactions, (unsigned long)moved_bytes);
+}
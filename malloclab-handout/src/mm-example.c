@@ -285,6 +285,15 @@ void *mm_realloc(void *ptr, size_t size)
     return newptr;
 }
 
+/*
+ * mm_usable_size - The payload of the block at bp, between its header
+ *     and its footer.
+ */
+size_t mm_usable_size(void *bp)
+{
+    return GET_SIZE(HDRP(bp)) - DSIZE;
+}
+
 static void *next_fit(size_t size)
 {
     void *bp;
@@ -16,6 +16,8 @@
 
 #include "mm.h"
 #include "memlib.h"
+#include "mmaccess.h"
+#include "mmphase.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -45,23 +47,49 @@ team_t team = {
 #define WSIZE 4 /* Word and header/footer size (bytes) */
 #define DSIZE 8 /* Double word size (bytes) */
 #define FSIZE 16
-#define CHUNKSIZE (1 << 10) /* Extend heap by this amount (bytes) */
+#define CHUNKSIZE (1 << 10) /* Smallest step of the adaptive heap growth (bytes) */
+#define MAXCHUNK (1 << 13)  /* Largest step of the adaptive heap growth (bytes) */
+#define BURST_ALLOCS 8      /* Fewer mallocs than this between extensions is a burst */
+#define MMAP_THRESHOLD (1 << 20) /* Requests this large get their own mapping */
+#define GROW_STEP (1 << 9)  /* Step of a block growing in place (bytes) */
+#define GROW_CALLS 16       /* Reallocs the headroom of a growing block should last */
+
+/* Deferred coalescing: small frees are parked on per-size quick lists */
+#define DEFER_COALESCE 1            /* 0 coalesces on every mm_free */
+#define QUICK_MAX 512               /* Largest block size kept on a quick list */
+#define QUICK_LISTS (QUICK_MAX / DSIZE + 1)
+#define DEFER_LIMIT (1 << 14)       /* Merge once this many bytes are parked */
+
+#define SLACK_MAX 128               /* Aligned allocation: smaller leading slack isn't freed */
+
+/* Learned size rounding: see learn_rounding */
+#define ROUND_MAX 4096              /* Largest block size that may be rounded up */
+#define ROUND_CLASSES (ROUND_MAX / DSIZE + 1)
+#define NEAR_MISSES 8               /* Free blocks just too small to count as a pattern */
+#define GROW_MISSES 8               /* Grown blocks of a class that count as a pattern */
+#define HIST_WINDOW 1024            /* Halve the size histogram after this many mallocs */
+#define COMMON_SHARE 4              /* A class with 1/COMMON_SHARE of the mallocs is common */
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
 
 /* Pack a size and allocated bit into a word */
 #define PACK(size, alloc) ((size) | (alloc))
 
-/* Read and write a word at address p */
-#define GET(p) (*(unsigned int *)(p))
-#define PUT(p, val) (*(unsigned int *)(p) = (val))
+/* Read and write a word at address p; logged with -DMM_MEMTRACE */
+#define GET(p) (*(unsigned int *)MMACCESS_READ(p))
+#define PUT(p, val) (*(unsigned int *)MMACCESS_WRITE(p) = (val))
 
-#define GET_INT(p) (*(int *)(p))
-#define PUT_INT(p, val) (*(int *)(p) = (val))
+#define GET_INT(p) (*(int *)MMACCESS_READ(p))
+#define PUT_INT(p, val) (*(int *)MMACCESS_WRITE(p) = (val))
 
 /* Read the size and allocated fields from address p 第一个字节*/
 #define GET_SIZE(p) (GET(p) & ~0x7)
 #define GET_ALLOC(p) (GET(p) & 0x1)
+#define GET_MAPPED(p) (GET(p) & 0x2) /* 块在独立的映射里，不在堆上 */
+#define GET_GROWN(p) (GET(p) & 0x4)  /* 已分配块被 realloc 变大过（只在头部） */
+#define SET_GROWN(p) (PUT(p, GET(p) | 0x4))
+#define GET_ZERO(p) (GET(p) & 0x2)   /* 空闲块：除了链接以外的内容全是零（只在空闲块上） */
 
 /* Given block ptr bp, compute address of its header and footer 是p后面的bp*/
 #define HDRP(bp) ((char *)(bp)-WSIZE)
@@ -76,13 +104,41 @@ team_t team = {
 #define NEXT(bp) ((char *)(bp + WSIZE))
 // root块的下一个空闲块
 #define RT_NEXT_FREEbp ((char *)(root + GET_INT(root)))
+// quick list 中下一个块相对 root 的偏移，0 表示链表结束
+#define QNEXT(bp) ((char *)(bp))
 
 static void *extend_heap(size_t words);
+static void *grow_heap(size_t asize);
+static void *map_block(size_t size);
+static void *remap_block(void *bp, size_t size);
+static void unmap_block(void *bp);
+static size_t adjust_size(size_t size);
+static int grow_in_place(void *bp, size_t asize);
+static int at_top(void *bp);
+static void *grow_down(void *bp, size_t asize);
+static void *move_to_top(size_t asize);
+static void learn_rounding(size_t asize);
+static void learn_growth(size_t size, size_t asize);
+static void count_size(size_t asize);
+static int is_common(size_t asize);
+static size_t round_size(size_t asize);
+static size_t carve(char *bp, size_t asize, size_t k, void **ptrs);
+static char *aligned_payload(char *bp, size_t align);
+static void *aligned_fit(size_t asize, size_t align);
+static void place_aligned(char *bp, char *p, size_t asize);
+static int cmp_addr(const void *a, const void *b);
 
 static void place(void *bp, size_t asize);
+static void *place_sized(char *bp, size_t asize);
+static long log2_fix(size_t x);
+static void release(void *bp);
 static void *coalesce(void *bp);
+static int defer_free(void *bp);
+static void merge_deferred(void);
 static void fix_ptr(void *bp);
 static void make_LIFO(char *bp);
+static int size_band(size_t size);
+static void count_search(size_t nodes);
 
 static void print_list();
 
@@ -93,6 +149,64 @@ static void *best_fit(size_t asize);
 static char *heap_listp;
 static char *root;
 
+static int quick[QUICK_LISTS];     /* Heads of the quick lists (offsets from root) */
+static size_t deferred_bytes;      /* Bytes parked on the quick lists */
+static unsigned long quick_hits;   /* Mallocs served from a quick list */
+static unsigned long batch_passes; /* Calls to merge_deferred */
+static unsigned long batch_merges; /* Blocks coalesced by merge_deferred */
+
+/*
+ * round_to[c] is the block size that requests of class c (asize / DSIZE)
+ * are rounded up to, or 0. Like the rest of the state it is reset by
+ * mm_init, so every replay learns it from its own requests.
+ */
+static unsigned short round_to[ROUND_CLASSES];
+static size_t near_size;            /* Largest free block best_fit saw below asize */
+static size_t near_count;           /* Free blocks of near_size seen by best_fit */
+static unsigned long rounded;       /* Mallocs whose size was rounded up */
+static long mean_log;               /* Running mean of log2_fix of the block sizes asked for */
+
+/*
+ * Histogram of the recent requests, kept by count_size: size_hist[c]
+ * counts the mallocs of class c and grow_hist[c] the blocks of class c
+ * that realloc later made bigger. Both are halved every HIST_WINDOW
+ * mallocs, so they follow the program's current size mix.
+ */
+static unsigned int size_hist[ROUND_CLASSES];
+static unsigned int grow_hist[ROUND_CLASSES];
+static unsigned int hist_total;     /* Sum of size_hist */
+
+static size_t grow_step;            /* Headroom for the block growing at the top */
+static unsigned long top_grows;     /* Reallocs of that block since the heap last grew for it */
+
+static size_t placed_zero;           /* The last block placed was known to be zero */
+static unsigned long calloc_bytes;   /* Bytes requested through mm_calloc */
+static unsigned long calloc_saved;   /* Of those, bytes that needed no memset */
+
+/* Counters behind mm_stats. fix_ptr and make_LIFO keep the free ones */
+static size_t free_bytes;                /* Bytes in blocks on the free list */
+static size_t free_blocks;               /* Blocks on the free list */
+static size_t free_band[MM_STAT_BANDS];  /* ... by size_band */
+static size_t sbrk_bytes;                /* Bytes from mem_sbrk */
+static size_t sbrk_calls;                /* Calls to mem_sbrk */
+static size_t mapped_bytes;              /* Bytes in mapped blocks */
+
+/* Counters behind mm_search_stats, kept by count_search */
+static size_t searches;                      /* Calls to the fit functions */
+static size_t search_nodes;                  /* Free blocks they visited */
+static size_t node_hist[MM_SEARCH_BANDS];    /* Searches by blocks visited */
+
+static size_t chunksize;             /* Current step of the adaptive heap growth */
+static unsigned long mallocs;        /* Calls to alloc_space so far */
+static unsigned long mallocs_at_grow; /* Value of mallocs at the last grow_heap */
+static unsigned long frees;          /* Blocks freed so far */
+static unsigned long frees_at_grow;  /* Value of frees at the last grow_heap */
+
+/* Phases timed when built with -DMM_PHASES, see mmphase.h */
+enum { PH_FIT, PH_PLACE, PH_COALESCE, PH_LIST, PH_EXTEND, NPHASES };
+static const char *const phase_names[NPHASES] = {
+    "best_fit", "place", "coalesce", "fix_ptr/make_LIFO", "extend_heap"};
+
 // static int i;
 
 /*
@@ -110,6 +224,31 @@ int mm_init(void)
 
     root = heap_listp;
     heap_listp += (2 * WSIZE);
+
+    memset(quick, 0, sizeof(quick));
+    deferred_bytes = 0;
+    quick_hits = batch_passes = batch_merges = 0;
+    chunksize = CHUNKSIZE;
+    mallocs = mallocs_at_grow = 0;
+    frees = frees_at_grow = 0;
+    memset(round_to, 0, sizeof(round_to));
+    rounded = 0;
+    mean_log = 0;
+    memset(size_hist, 0, sizeof(size_hist));
+    memset(grow_hist, 0, sizeof(grow_hist));
+    hist_total = 0;
+    grow_step = GROW_STEP;
+    top_grows = 0;
+    calloc_bytes = 0;
+    calloc_saved = 0;
+    free_bytes = free_blocks = 0;
+    memset(free_band, 0, sizeof(free_band));
+    sbrk_bytes = 4 * WSIZE;
+    sbrk_calls = 1;
+    mapped_bytes = 0;
+    searches = search_nodes = 0;
+    memset(node_hist, 0, sizeof(node_hist));
+    PHASE_INIT(phase_names, NPHASES);
     /* Extend the empty heap with a free block of CHUNKSIZE bytes */
     // if (extend_heap(CHUNKSIZE/WSIZE) == NULL)
     //     return -1;
@@ -123,28 +262,72 @@ static void *extend_heap(size_t words)
     size_t size;
 
     // printf("in extend_heap\n");
+    PHASE_ENTER(PH_EXTEND);
     /* Allocate an even number of words to maintain alignment 8字节对齐*/
     size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
 
     if ((long)(bp = mem_sbrk(size)) == -1)
+    {
+        PHASE_EXIT(PH_EXTEND);
         return NULL;
+    }
+    sbrk_bytes += size;
+    sbrk_calls++;
     /* Initialize free block header/footer and the epilogue header */
-    PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
-    PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
+    PUT(HDRP(bp), PACK(size, 0x2));       /* Free block header, still zero */
+    PUT(FTRP(bp), PACK(size, 0x2));       /* Free block footer */
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* 新的尾部 */
 
     PUT_INT(PREV(bp), 0); // 前驱置为0
     PUT_INT(NEXT(bp), 0); // 后继置为0
     bp = coalesce(bp);
+    PHASE_EXIT(PH_EXTEND);
     return bp;
 }
 
+/*
+ * grow_heap - Extend the heap so that a block of asize bytes fits at its
+ *     end. A free block already at the top of the heap counts towards
+ *     asize, so normally only the deficit is requested. While the heap is
+ *     growing in bursts (few mallocs, or no frees, between extensions)
+ *     the step doubles up to MAXCHUNK to save mem_sbrk calls, but stays
+ *     below an eighth of the heap, so that a small heap doesn't end in a
+ *     big unused step; once growth slows down it halves back to
+ *     CHUNKSIZE to avoid leaving unused space at the top. Bigger steps also keep the blocks of a phase
+ *     that only allocates close together, so that their holes coalesce
+ *     when they are freed.
+ */
+static void *grow_heap(size_t asize)
+{
+    char *last_ftr = (char *)mem_heap_hi() + 1 - DSIZE; // 最后一个块的尾部
+    size_t top = GET_ALLOC(last_ftr) ? 0 : GET_SIZE(last_ftr);
+    size_t want = asize;
+
+    if (top >= asize) // 堆顶的空闲块已经够大
+        return last_ftr + DSIZE - top;
+
+    if (mallocs - mallocs_at_grow < BURST_ALLOCS || frees == frees_at_grow)
+    {
+        chunksize = MIN(2 * chunksize, MIN(MAXCHUNK, MAX(CHUNKSIZE, sbrk_bytes / 8)));
+        want = MAX(chunksize, asize);
+    }
+    else if (chunksize > CHUNKSIZE)
+        chunksize /= 2;
+    mallocs_at_grow = mallocs;
+    frees_at_grow = frees;
+
+    return extend_heap(MAX(want - top, 2 * DSIZE) / WSIZE);
+}
+
 static void place(void *bp, size_t asize)
 {
     // printf("in place\n");
+    PHASE_ENTER(PH_PLACE);
 
     size_t size = GET_SIZE(HDRP(bp)); // 当前块的大小
+    size_t zero = GET_ZERO(HDRP(bp)); // 剩下的部分仍然是零
     fix_ptr(bp);                      // 修正指针
+    placed_zero = zero;
 
     if ((size - asize) >= (2 * DSIZE))
     {
@@ -153,8 +336,8 @@ static void place(void *bp, size_t asize)
         PUT(FTRP(bp), PACK(asize, 1));
 
         void *bp1 = NEXT_BLKP(bp);
-        PUT(HDRP(bp1), PACK(size - asize, 0));
-        PUT(FTRP(bp1), PACK(size - asize, 0));
+        PUT(HDRP(bp1), PACK(size - asize, zero));
+        PUT(FTRP(bp1), PACK(size - asize, zero));
 
         PUT_INT(PREV(bp1), 0); // 前驱置为0
         PUT_INT(NEXT(bp1), 0); // 后继置为0
@@ -166,10 +349,60 @@ static void place(void *bp, size_t asize)
         PUT(HDRP(bp), PACK(size, 1));
         PUT(FTRP(bp), PACK(size, 1));
     }
+    PHASE_EXIT(PH_PLACE);
+}
+
+/*
+ * place_sized - Place a block of asize bytes in the free block bp like
+ *     place, except that blocks of a common size (see is_common) more
+ *     than twice the running geometric mean of the requests go to the
+ *     high end of bp. Small and big blocks then collect at opposite ends
+ *     of the space they are carved from, and when the big ones are freed
+ *     their holes are adjacent and coalesce instead of being kept apart
+ *     by small blocks. A big size that is rare gains nothing from this
+ *     and stays at the low end. Returns the block.
+ */
+static void *place_sized(char *bp, size_t asize)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t zero = GET_ZERO(HDRP(bp));
+    char *p;
+
+    if (log2_fix(asize) <= mean_log + 256 || !is_common(asize) ||
+        size - asize < 2 * DSIZE)
+    {
+        place(bp, asize);
+        return bp;
+    }
+    PHASE_ENTER(PH_PLACE);
+    fix_ptr(bp);
+    placed_zero = zero;
+    PUT(HDRP(bp), PACK(size - asize, zero)); // 剩下的部分留在低端
+    PUT(FTRP(bp), PACK(size - asize, zero));
+    PUT_INT(PREV(bp), 0);
+    PUT_INT(NEXT(bp), 0);
+    make_LIFO(bp);
+    p = NEXT_BLKP(bp);
+    PUT(HDRP(p), PACK(asize, 1));
+    PUT(FTRP(p), PACK(asize, 1));
+    PHASE_EXIT(PH_PLACE);
+    return p;
+}
+
+/*
+ * log2_fix - log2(x) in 1/256ths, interpolating linearly between powers
+ *     of two; x > 0.
+ */
+static long log2_fix(size_t x)
+{
+    int msb = 63 - __builtin_clzl(x);
+
+    return ((long)msb << 8) + (long)((x << 8 >> msb) - 256);
 }
 
 /*
- * mm_free - Freeing a block does nothing.
+ * mm_free - Free a block. Small blocks are parked on a quick list and
+ *     coalesced later by merge_deferred; the rest are coalesced now.
  */
 void mm_free(void *bp)
 {
@@ -178,7 +411,64 @@ void mm_free(void *bp)
     {
         return;
     }
+    frees++;
+    if (GET_MAPPED(HDRP(bp)))
+    {
+        unmap_block(bp);
+        return;
+    }
+#if DEFER_COALESCE
+    if (defer_free(bp))
+        return;
+#endif
+    release(bp);
+}
+
+/*
+ * mm_free_sized - mm_free for callers that know the size they asked
+ *     for. Every block is at least adjust_size(size) bytes and blocks
+ *     below MMAP_THRESHOLD are never mapped, so a small block goes onto
+ *     the quick list for that size without decoding its header. A quick
+ *     list can thus hold blocks a little bigger than its size; they keep
+ *     their real size in the header. Larger blocks may be mapped or, from
+ *     mm_memalign, on the heap; mm_free tells them apart. With -DDEBUG
+ *     the size is checked against the header.
+ */
+void mm_free_sized(void *bp, size_t size)
+{
+    if (bp == NULL)
+        return;
+#ifdef DEBUG
+    if (GET_SIZE(HDRP(bp)) < adjust_size(size) ||
+        (GET_MAPPED(HDRP(bp)) && size < MMAP_THRESHOLD))
+    {
+        fprintf(stderr, "mm_free_sized: %p is a block of %u bytes, not %zu\n",
+                bp, GET_SIZE(HDRP(bp)), size);
+        abort();
+    }
+#endif
+#if DEFER_COALESCE
+    size_t asize = adjust_size(size);
 
+    if (size < MMAP_THRESHOLD && asize <= QUICK_MAX)
+    {
+        frees++;
+        PUT_INT(QNEXT(bp), quick[asize / DSIZE]);
+        quick[asize / DSIZE] = (int)((char *)bp - root);
+        deferred_bytes += asize;
+        if (deferred_bytes >= DEFER_LIMIT)
+            merge_deferred();
+        return;
+    }
+#endif
+    mm_free(bp);
+}
+
+/*
+ * release - Mark a heap block free and coalesce it right away.
+ */
+static void release(void *bp)
+{
     size_t size = GET_SIZE(HDRP(bp));
 
     PUT(HDRP(bp), PACK(size, 0));
@@ -193,71 +483,352 @@ void mm_free(void *bp)
 static void *coalesce(void *bp)
 {
     // printf("in coalesce\n");
+    PHASE_ENTER(PH_COALESCE);
     size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp))); // 前一个块的尾部
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp))); // 后一个块的头部
     size_t size = GET_SIZE(HDRP(bp));                   // 当前块的大小
+    size_t zero = GET_ZERO(HDRP(bp));                   // 合并后是否仍然全零
     if (prev_alloc && next_alloc)                       // 都是已分配的情况
     {                                                   // Case 1
     }
     else if (prev_alloc && !next_alloc)
     {                                          /* Case 2 下一个是空的*/
         size += GET_SIZE(HDRP(NEXT_BLKP(bp))); // 合并大小
+        zero &= GET_ZERO(HDRP(NEXT_BLKP(bp)));
         fix_ptr(NEXT_BLKP(bp));                // 修正指针
-        PUT(HDRP(bp), PACK(size, 0));
-        PUT(FTRP(bp), PACK(size, 0));
+        if (zero) // 交界处的尾部、头部和链接变成了负载，清零
+            memset(FTRP(bp), 0, 2 * DSIZE);
+        PUT(HDRP(bp), PACK(size, zero));
+        PUT(FTRP(bp), PACK(size, zero));
     }
 
     else if (!prev_alloc && next_alloc)
     { /* Case 3 上一个是空的*/
-        size += GET_SIZE(HDRP(PREV_BLKP(bp)));
-        fix_ptr(PREV_BLKP(bp)); // 修正指针
-        PUT(FTRP(bp), PACK(size, 0));
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp); // 指针指向新的块
+        char *prev = PREV_BLKP(bp);
+        size += GET_SIZE(HDRP(prev));
+        zero &= GET_ZERO(HDRP(prev));
+        fix_ptr(prev); // 修正指针
+        PUT(FTRP(bp), PACK(size, zero));
+        PUT(HDRP(prev), PACK(size, zero));
+        if (zero)
+            memset(HDRP(bp) - WSIZE, 0, 2 * DSIZE);
+        bp = prev; // 指针指向新的块
     }
     else
     { /* Case 4 */
-        size += GET_SIZE(HDRP(PREV_BLKP(bp))) +
+        char *prev = PREV_BLKP(bp);
+        size += GET_SIZE(HDRP(prev)) +
                 GET_SIZE(FTRP(NEXT_BLKP(bp)));
-        fix_ptr(PREV_BLKP(bp)); // 修正指针
+        zero &= GET_ZERO(HDRP(prev)) & GET_ZERO(HDRP(NEXT_BLKP(bp)));
+        fix_ptr(prev);          // 修正指针
         fix_ptr(NEXT_BLKP(bp)); // 修正指针
 
-        PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
-        PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
-        bp = PREV_BLKP(bp);
+        PUT(HDRP(prev), PACK(size, zero));
+        PUT(FTRP(NEXT_BLKP(bp)), PACK(size, zero));
+        if (zero)
+        {
+            memset(FTRP(bp), 0, 2 * DSIZE);
+            memset(HDRP(bp) - WSIZE, 0, 2 * DSIZE);
+        }
+        bp = prev;
     }
     make_LIFO(bp);
 
     // printf("out coalesce\n");
+    PHASE_EXIT(PH_COALESCE);
     return bp;
 }
 
+/*
+ * adjust_size - Block size for a request: payload plus header and footer,
+ *     rounded up to the alignment and at least the minimum block size.
+ */
+static size_t adjust_size(size_t size)
+{
+    if (size <= DSIZE) // 调整为至少16个字节
+        return 2 * DSIZE;
+    return DSIZE * ((size + (DSIZE) + (DSIZE - 1)) / DSIZE); // 调整为8的倍数
+}
+
+/*
+ * grow_in_place - Try to make the allocated block bp at least asize bytes
+ *     without moving it, by absorbing a free block that follows it. A
+ *     block at the top of the heap grows by extending the heap by the
+ *     deficit, but at least grow_step, and keeps all of it as headroom.
+ *     grow_step is what the block grew by per realloc since the last
+ *     extension, times GROW_CALLS, and at most GROW_STEP: a block that
+ *     grows a little at a time doesn't leave a big unused step at the
+ *     top. Returns 1 on success and 0 if bp has to move.
+ */
+static int grow_in_place(void *bp, size_t asize)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *next = NEXT_BLKP(bp);
+    size_t avail = size;
+    size_t top, keep = 0;
+
+    if (at_top(bp))
+        top_grows++;
+    if (asize <= size)
+        return 1;
+    if (at_top(bp))
+    {
+        /* 紧挨着堆顶：补上差额，至少 grow_step，全部留给这个块 */
+        top = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+        if (size + top < asize)
+        {
+            grow_step = MIN(MAX(grow_step / top_grows * GROW_CALLS, 2 * DSIZE), GROW_STEP);
+            grow_step = DSIZE * ((grow_step + DSIZE - 1) / DSIZE);
+            top_grows = 0;
+            if (extend_heap(MAX(asize - size - top, grow_step) / WSIZE) == NULL)
+                return 0;
+        }
+        next = NEXT_BLKP(bp);
+        avail = size + GET_SIZE(HDRP(next));
+        keep = avail;
+    }
+    else if (!GET_ALLOC(HDRP(next)))
+        avail += GET_SIZE(HDRP(next));
+    if (avail < asize)
+        return 0;
+
+    fix_ptr(next);
+    if (avail - asize >= 2 * DSIZE && avail != keep)
+    {
+        PUT(HDRP(bp), PACK(asize, 1));
+        PUT(FTRP(bp), PACK(asize, 1));
+        next = NEXT_BLKP(bp);
+        PUT(HDRP(next), PACK(avail - asize, 0));
+        PUT(FTRP(next), PACK(avail - asize, 0));
+        PUT_INT(PREV(next), 0);
+        PUT_INT(NEXT(next), 0);
+        make_LIFO(next);
+    }
+    else
+    {
+        PUT(HDRP(bp), PACK(avail, 1));
+        PUT(FTRP(bp), PACK(avail, 1));
+    }
+    SET_GROWN(HDRP(bp));
+    return 1;
+}
+
+/*
+ * at_top - Whether only the epilogue, or a free block and the epilogue,
+ *     follow the block bp, so that bp can grow by extending the heap.
+ */
+static int at_top(void *bp)
+{
+    char *next = NEXT_BLKP(bp);
+
+    return GET_SIZE(HDRP(next)) == 0 ||
+           (!GET_ALLOC(HDRP(next)) && GET_SIZE(HDRP(NEXT_BLKP(next))) == 0);
+}
+
+/*
+ * grow_down - Try to make the allocated block bp at least asize bytes by
+ *     taking the upper part of a free block of at least GROW_STEP bytes
+ *     just before it, and the free block after it, moving the payload
+ *     down. Returns NULL if the block after bp is enough by itself, for
+ *     grow_in_place to take without a copy, or if this doesn't work. At
+ *     the top of the heap this comes before extending the heap: a block
+ *     that keeps growing there would otherwise leave the hole it was
+ *     first moved out of behind for good. There it takes at least
+ *     GROW_STEP, so that it doesn't move on every call, and keeps all of
+ *     it as headroom; the rest of the hole is left to small blocks, or
+ *     taken too if it is smaller than GROW_STEP, since grow_down could
+ *     not take it later.
+ */
+static void *grow_down(void *bp, size_t asize)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    char *next = NEXT_BLKP(bp);
+    char *prev, *newbp;
+    size_t psize, nsize, need;
+    int top = at_top(bp);
+
+    nsize = GET_ALLOC(HDRP(next)) ? 0 : GET_SIZE(HDRP(next));
+    if (size + nsize >= asize)
+        return NULL;
+#if DEFER_COALESCE
+    if (top && deferred_bytes != 0 && GET_ALLOC(HDRP(bp) - WSIZE))
+        merge_deferred(); // 前一个块可能只是停在快速链表上
+#endif
+    if (GET_ALLOC(HDRP(bp) - WSIZE)) // 前一个块的尾部
+        return NULL;
+    prev = PREV_BLKP(bp);
+    psize = GET_SIZE(HDRP(prev));
+    need = asize - size - nsize;
+    if (psize < GROW_STEP || psize < need)
+        return NULL;
+    if (top)
+        need = MIN(MAX(need, GROW_STEP), psize);
+    if (psize - need < (top ? GROW_STEP : 2 * DSIZE)) // 剩下的太小，整个拿走
+        need = psize;
+
+    fix_ptr(prev);
+    if (nsize != 0)
+        fix_ptr(next);
+    newbp = prev + (psize - need);
+    memmove(newbp, bp, size - DSIZE);
+    if (need < psize)
+    {
+        PUT(HDRP(prev), PACK(psize - need, 0));
+        PUT(FTRP(prev), PACK(psize - need, 0));
+        PUT_INT(PREV(prev), 0);
+        PUT_INT(NEXT(prev), 0);
+        make_LIFO(prev);
+    }
+    size += need + nsize;
+    PUT(HDRP(newbp), PACK(size, 1));
+    PUT(FTRP(newbp), PACK(size, 1));
+    SET_GROWN(HDRP(newbp));
+    return newbp;
+}
+
+/*
+ * move_to_top - Allocate a block of at least asize bytes at the top of
+ *     the heap for a block that keeps growing. There it can grow further
+ *     by extending the heap, and it keeps the whole top block as headroom
+ *     rather than splitting off a remainder for a small block to land on.
+ */
+static void *move_to_top(size_t asize)
+{
+    char *bp;
+    size_t size;
+
+    if ((bp = grow_heap(asize)) == NULL)
+        return NULL;
+    fix_ptr(bp);
+    size = GET_SIZE(HDRP(bp));
+    PUT(HDRP(bp), PACK(size, 1));
+    PUT(FTRP(bp), PACK(size, 1));
+    return bp;
+}
+
+/*
+ * learn_rounding - Called when no free block fits asize. If best_fit saw
+ *     several free blocks of one size that were only a little too small,
+ *     blocks of that size are being freed and then wanted back somewhat
+ *     bigger. If that size is also common, round it up to asize from now
+ *     on, so that the holes those blocks leave behind fit the bigger
+ *     requests.
+ */
+static void learn_rounding(size_t asize)
+{
+    if (near_count < NEAR_MISSES || !is_common(near_size))
+        return;
+    if (near_size + near_size / 4 < asize) // 差得太多就不取整，免得浪费
+        return;
+    if (round_to[near_size / DSIZE] < asize)
+        round_to[near_size / DSIZE] = (unsigned short)asize;
+}
+
+/*
+ * learn_growth - Called when realloc makes a block of size bytes, fresh
+ *     from malloc, at least asize bytes. If most blocks of that class
+ *     grow this way, round the class up to asize from now on, so that
+ *     later blocks have the room when realloc asks for it.
+ */
+static void learn_growth(size_t size, size_t asize)
+{
+    int c = size / DSIZE;
+
+    if (asize <= size || asize > ROUND_MAX)
+        return;
+    if (++grow_hist[c] < GROW_MISSES || 2 * grow_hist[c] < size_hist[c])
+        return;
+    if (round_to[c] < asize)
+        round_to[c] = (unsigned short)asize;
+}
+
+/*
+ * count_size - Add a malloc of asize bytes to the size histogram.
+ */
+static void count_size(size_t asize)
+{
+    int c;
+
+    if (asize > ROUND_MAX)
+        return;
+    size_hist[asize / DSIZE]++;
+    if (++hist_total < HIST_WINDOW)
+        return;
+    for (c = 0; c < ROUND_CLASSES; c++) // 减半，老的请求渐渐不算数
+    {
+        size_hist[c] /= 2;
+        grow_hist[c] /= 2;
+    }
+    hist_total /= 2;
+}
+
+/*
+ * is_common - Whether at least 1/COMMON_SHARE of the recent mallocs
+ *     asked for blocks of asize bytes.
+ */
+static int is_common(size_t asize)
+{
+    return asize <= ROUND_MAX &&
+           size_hist[asize / DSIZE] * COMMON_SHARE >= hist_total;
+}
+
+/*
+ * round_size - Apply the rounding learned by learn_rounding and
+ *     learn_growth to asize.
+ */
+static size_t round_size(size_t asize)
+{
+    if (asize <= ROUND_MAX && round_to[asize / DSIZE] != 0)
+    {
+        rounded++;
+        return round_to[asize / DSIZE];
+    }
+    return asize;
+}
+
 void *alloc_space(size_t size)
 {
     size_t asize;      /* Adjusted block size */
-    size_t extendsize; /* Amount to extend heap if no fit */
     char *bp;
 
-    /* Adjust block size to include overhead and alignment reqs. */
-    if (size <= DSIZE) // 调整为至少16个字节
-        asize = 2 * DSIZE;
-    else
-        asize = DSIZE * ((size + (DSIZE) + (DSIZE - 1)) / DSIZE); // 调整为8的倍数
-    if ((bp = find_fit(asize)) != NULL)
+    mallocs++;
+
+    /* Large blocks bypass the heap so realloc can resize them with mremap */
+    if (size >= MMAP_THRESHOLD)
+        return map_block(size);
+
+    asize = round_size(adjust_size(size));
+    mean_log += (log2_fix(asize) - mean_log) / 16;
+    count_size(asize);
+#if DEFER_COALESCE
+    /* An exact-size block parked by mm_free needs neither a split nor a merge */
+    if (asize <= QUICK_MAX && quick[asize / DSIZE] != 0)
     {
-        // printf("find fit\n");
-        place(bp, asize);
-        // printf("bp: %p\n", bp);
+        bp = root + quick[asize / DSIZE];
+        quick[asize / DSIZE] = GET_INT(QNEXT(bp));
+        PUT(HDRP(bp), GET(HDRP(bp)) & ~0x4); // 清掉上一个主人的 GROWN 位，大小不变
+        deferred_bytes -= asize;
+        quick_hits++;
         return bp;
     }
+#endif
+    if ((bp = find_fit(asize)) != NULL)
+        return place_sized(bp, asize);
+#if DEFER_COALESCE
+    /* 合并所有推迟的块之后再找一次，找不到才扩展堆 */
+    if (deferred_bytes != 0)
+    {
+        merge_deferred();
+        if ((bp = find_fit(asize)) != NULL)
+            return place_sized(bp, asize);
+    }
+#endif
 
     /* 放不下的话，扩展新空间，在新的块里面放置 */
-    extendsize = MAX(CHUNKSIZE, asize);
-    if ((bp = extend_heap(extendsize / WSIZE)) == NULL)
+    learn_rounding(asize);
+    if ((bp = grow_heap(asize)) == NULL)
         return NULL;
-    // printf("extend success\n");
-    place(bp, asize);
-    return bp;
+    return place_sized(bp, asize);
 }
 
 /*
@@ -276,42 +847,326 @@ void *mm_malloc(size_t size)
         return NULL;
     }
 
-    if (size == 112)
-        return alloc_space(128);
-    if (size == 448)
-        return alloc_space(512);
-    if (size == 16)
+    return alloc_space(size);
+}
+
+/*
+ * mm_calloc - Allocate zeroed memory for an array of nmemb elements of
+ *     size bytes each. Blocks carved from memory nobody has written yet
+ *     (a fresh heap extension or a new mapping, see GET_ZERO) only need
+ *     their first DSIZE bytes cleared, where the free-list links were.
+ */
+void *mm_calloc(size_t nmemb, size_t size)
+{
+    size_t bytes;
+    char *bp;
+
+    if (size != 0 && nmemb > (size_t)-1 / size) // 乘法溢出
+        return NULL;
+    bytes = nmemb * size;
+
+    placed_zero = 0; // 从快速链表取出的块不会经过 place，视为脏的
+    if ((bp = mm_malloc(bytes)) == NULL)
+        return NULL;
+    calloc_bytes += bytes;
+    if (placed_zero)
+    {
+        memset(bp, 0, MIN(bytes, DSIZE));
+        calloc_saved += bytes - MIN(bytes, DSIZE);
+    }
+    else
+        memset(bp, 0, bytes);
+    return bp;
+}
+
+/*
+ * mm_usable_size - The payload of the block at bp: everything between
+ *     the header and the footer. Mapped blocks have no footer, but the
+ *     same number of bytes in front of the payload.
+ */
+size_t mm_usable_size(void *bp)
+{
+    return GET_SIZE(HDRP(bp)) - DSIZE;
+}
+
+/*
+ * mm_memalign - Allocate size bytes whose address is a multiple of
+ *     align, a power of two. The search looks for a free block that
+ *     holds an aligned payload of the right size, and the slack in front
+ *     of that payload is split off (see place_aligned) instead of being
+ *     wasted. Aligned blocks always come from the heap, even when they
+ *     are large.
+ */
+void *mm_memalign(size_t align, size_t size)
+{
+    size_t asize;
+    char *bp, *p;
+
+    if (align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+    if (align <= ALIGNMENT)
+        return mm_malloc(size);
+    if (size == 0)
+        return NULL;
+
+    mallocs++;
+    asize = adjust_size(size);
+    if ((bp = aligned_fit(asize, align)) == NULL)
+    {
+#if DEFER_COALESCE
+        if (deferred_bytes != 0)
+            merge_deferred();
+        bp = aligned_fit(asize, align);
+#endif
+        /* 最坏情况下对齐要浪费 align + 2 * DSIZE 字节，按这个扩展堆 */
+        if (bp == NULL && (bp = grow_heap(asize + align + 2 * DSIZE)) == NULL)
+            return NULL;
+    }
+    p = aligned_payload(bp, align);
+    place_aligned(bp, p, asize);
+    return p;
+}
+
+/*
+ * mm_aligned_alloc - C11 aligned_alloc. Unlike the standard, size does
+ *     not have to be a multiple of align.
+ */
+void *mm_aligned_alloc(size_t align, size_t size)
+{
+    return mm_memalign(align, size);
+}
+
+/*
+ * aligned_payload - The first payload address in the free block bp that
+ *     is a multiple of align and leaves either no slack in front or
+ *     enough for a free block (2 * DSIZE bytes).
+ */
+static char *aligned_payload(char *bp, size_t align)
+{
+    char *p = (char *)(((unsigned long)bp + align - 1) & ~(unsigned long)(align - 1));
+
+    if (p != bp && p - bp < 2 * DSIZE)
+        p += align;
+    return p;
+}
+
+/*
+ * aligned_fit - Best fit for an aligned payload of asize bytes: the
+ *     smallest free block that holds one after its leading slack.
+ */
+static void *aligned_fit(size_t asize, size_t align)
+{
+    char *bp, *best_bp = NULL;
+    size_t size, min_size = 0, nodes = 0;
+
+    if (GET_INT(root) == 0)
+    {
+        count_search(0);
+        return NULL;
+    }
+    for (bp = RT_NEXT_FREEbp;; bp = bp + GET_INT(NEXT(bp)))
     {
-        void *p1 = alloc_space(16);
-        void *p2 = alloc_space(16);
-        if (p1 < p2)
+        size = GET_SIZE(HDRP(bp));
+        nodes++;
+        if (size >= asize && (min_size == 0 || size < min_size) &&
+            (size_t)(aligned_payload(bp, align) - bp) + asize <= size)
         {
-            mm_free(p1);
-            return p2;
+            min_size = size;
+            best_bp = bp;
         }
-        else
+        if (GET_INT(NEXT(bp)) == 0)
+            break;
+    }
+    count_search(nodes);
+    return best_bp;
+}
+
+/*
+ * place_aligned - Allocate asize bytes at payload p inside the free block
+ *     bp. The slack in front of p becomes a free block of its own, or,
+ *     if it is at most SLACK_MAX bytes, part of the allocated block in
+ *     front of bp: such small free blocks are rarely reused and only
+ *     make every search longer. place splits off whatever is left
+ *     behind the new block.
+ */
+static void place_aligned(char *bp, char *p, size_t asize)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+    size_t lead = p - bp;
+
+    if (lead != 0 && lead <= SLACK_MAX)
+    {
+        /* 小空隙并给前一个（已分配的）块，不让空闲链表里堆满碎块 */
+        char *prev = PREV_BLKP(bp);
+        size_t psize = GET_SIZE(HDRP(prev)) + lead;
+
+        fix_ptr(bp);
+        PUT(HDRP(prev), PACK(psize, GET(HDRP(prev)) & 0x7));
+        PUT(FTRP(prev), PACK(psize, 1));
+        PUT(HDRP(p), PACK(size - lead, 0));
+        PUT(FTRP(p), PACK(size - lead, 0));
+        PUT_INT(PREV(p), 0);
+        PUT_INT(NEXT(p), 0);
+        make_LIFO(p);
+    }
+    else if (lead != 0)
+    {
+        fix_ptr(bp);
+        PUT(HDRP(bp), PACK(lead, 0)); // 前面的空隙单独成为一个空闲块
+        PUT(FTRP(bp), PACK(lead, 0));
+        PUT_INT(PREV(bp), 0);
+        PUT_INT(NEXT(bp), 0);
+        make_LIFO(bp);
+        PUT(HDRP(p), PACK(size - lead, 0));
+        PUT(FTRP(p), PACK(size - lead, 0));
+        PUT_INT(PREV(p), 0);
+        PUT_INT(NEXT(p), 0);
+        make_LIFO(p);
+    }
+    place(p, asize);
+}
+
+/*
+ * mm_malloc_batch - Allocate n blocks of size bytes each and store them
+ *     in ptrs. Exact-size blocks waiting on a quick list are used first;
+ *     the rest are carved one after another out of a single free block
+ *     (or heap extension) big enough for all of them, so there is one
+ *     search and one split for the whole batch. If no free block is big
+ *     enough, the free blocks that hold at least one are carved up first.
+ *     Returns the number of blocks allocated, which is less than n only
+ *     if memory ran out.
+ */
+size_t mm_malloc_batch(size_t size, size_t n, void **ptrs)
+{
+    size_t asize, total, i = 0;
+    char *bp;
+
+    if (size == 0)
+        return 0;
+    if (size >= MMAP_THRESHOLD || n < 2)
+    {
+        for (; i < n; i++)
+            if ((ptrs[i] = alloc_space(size)) == NULL)
+                break;
+        return i;
+    }
+
+    asize = round_size(adjust_size(size));
+    mallocs += n;
+#if DEFER_COALESCE
+    if (asize <= QUICK_MAX)
+    {
+        for (; i < n && quick[asize / DSIZE] != 0; i++)
         {
-            mm_free(p2);
-            return p1;
+            bp = root + quick[asize / DSIZE];
+            quick[asize / DSIZE] = GET_INT(QNEXT(bp));
+            PUT(HDRP(bp), GET(HDRP(bp)) & ~0x4);
+            deferred_bytes -= asize;
+            quick_hits++;
+            ptrs[i] = bp;
         }
+        if (i == n)
+            return n;
+    }
+#endif
+    total = (n - i) * asize;
+    if ((bp = find_fit(total)) == NULL)
+    {
+#if DEFER_COALESCE
+        if (deferred_bytes != 0)
+            merge_deferred();
+        bp = find_fit(total);
+#endif
     }
-    if (size == 128)
+    if (bp == NULL)
     {
-        void *p1 = alloc_space(128);
-        void *p2 = alloc_space(128);
-        if (p1 < p2)
+        /* 没有一块放得下整批：先把放得下的空闲块切完，剩下的再扩展堆 */
+        char *next;
+        size_t k;
+
+        bp = GET_INT(root) ? RT_NEXT_FREEbp : NULL;
+        for (; bp != NULL && i < n; bp = next)
         {
-            mm_free(p1);
-            return p2;
+            next = GET_INT(NEXT(bp)) ? bp + GET_INT(NEXT(bp)) : NULL;
+            k = MIN(n - i, GET_SIZE(HDRP(bp)) / asize);
+            if (k > 0)
+                i += carve(bp, asize, k, ptrs + i);
         }
-        else
+        if (i == n)
+            return n;
+        total = (n - i) * asize;
+        if ((bp = grow_heap(total)) == NULL)
+            return i;
+    }
+    return i + carve(bp, asize, n - i, ptrs + i);
+}
+
+/*
+ * carve - Allocate k blocks of asize bytes back to back from the start
+ *     of the free block bp, which must hold at least k * asize bytes.
+ *     The rest of bp stays free, unless it is too small for a block of
+ *     its own and goes to the last block. Returns k.
+ */
+static size_t carve(char *bp, size_t asize, size_t k, void **ptrs)
+{
+    size_t i, left;
+
+    place(bp, k * asize);
+    left = GET_SIZE(HDRP(bp));
+    for (i = 0; i < k - 1; i++)
+    {
+        PUT(HDRP(bp), PACK(asize, 1));
+        PUT(FTRP(bp), PACK(asize, 1));
+        ptrs[i] = bp;
+        bp = NEXT_BLKP(bp);
+        left -= asize;
+    }
+    PUT(HDRP(bp), PACK(left, 1));
+    PUT(FTRP(bp), PACK(left, 1));
+    ptrs[i] = bp;
+    return k;
+}
+
+/*
+ * mm_free_batch - Free n blocks at once. The pointers are sorted by
+ *     address (ptrs is reordered), so that runs of blocks that are
+ *     neighbours in the heap become one free block with a single
+ *     header, footer and coalesce.
+ */
+void mm_free_batch(void **ptrs, size_t n)
+{
+    size_t i, size;
+    char *bp;
+
+    frees += n;
+    qsort(ptrs, n, sizeof(void *), cmp_addr);
+    for (i = 0; i < n; i++)
+    {
+        if (ptrs[i] == NULL)
+            continue;
+        bp = ptrs[i];
+        if (GET_MAPPED(HDRP(bp)))
         {
-            mm_free(p2);
-            return p1;
+            unmap_block(bp);
+            continue;
         }
+        size = GET_SIZE(HDRP(bp));
+        while (i + 1 < n && (char *)ptrs[i + 1] == bp + size) // 物理上相邻的块连成一段
+            size += GET_SIZE(HDRP(ptrs[++i]));
+        PUT(HDRP(bp), PACK(size, 0));
+        PUT(FTRP(bp), PACK(size, 0));
+        PUT_INT(PREV(bp), 0);
+        PUT_INT(NEXT(bp), 0);
+        coalesce(bp);
     }
+}
 
-    return alloc_space(size);
+static int cmp_addr(const void *a, const void *b)
+{
+    char *p = *(char *const *)a;
+    char *q = *(char *const *)b;
+
+    return (p > q) - (p < q);
 }
 
 void *mm_realloc(void *ptr, size_t size)
@@ -323,15 +1178,49 @@ void *mm_realloc(void *ptr, size_t size)
         mm_free(ptr);
         return NULL;
     }
+    if (GET_MAPPED(HDRP(ptr)))
+    {
+        if (size >= MMAP_THRESHOLD)
+            return remap_block(ptr, size);
+        /* 缩到阈值以下就搬回堆里：映射块的大小总是 >= MMAP_THRESHOLD */
+        void *heapptr = alloc_space(size);
+        if (heapptr == NULL)
+            return NULL;
+        memcpy(heapptr, ptr, size);
+        unmap_block(ptr);
+        return heapptr;
+    }
+    if (size < MMAP_THRESHOLD)
+    {
+        if (!GET_GROWN(HDRP(ptr)))
+            learn_growth(GET_SIZE(HDRP(ptr)), adjust_size(size));
+        void *lowptr = grow_down(ptr, adjust_size(size));
+        if (lowptr != NULL)
+            return lowptr;
+        if (grow_in_place(ptr, adjust_size(size)))
+            return ptr;
+    }
     size_t old_size = GET_SIZE(HDRP(ptr));
-    char temp[old_size];
-    memmove(temp, ptr, old_size);
-    mm_free(ptr);
-    void *newptr = alloc_space(size);
-    size_t copy_size = old_size - WSIZE;
+    int grown = GET_GROWN(HDRP(ptr));
+    void *newptr;
+    if (size >= MMAP_THRESHOLD)
+        newptr = alloc_space(size);
+    /* 反复变大的块放到堆顶；但堆里一半以上是空闲块时先找空位，
+       否则很多块轮流变大时每次都扩展堆，空闲块永远用不上 */
+    else if ((!grown || free_bytes > sbrk_bytes / 2) &&
+             (newptr = find_fit(adjust_size(size))) != NULL)
+        place(newptr, adjust_size(size));
+    else // 反复变大的块，或者本来就要扩展堆：放到堆顶
+        newptr = move_to_top(adjust_size(size));
+    if (newptr == NULL) // 失败时原来的块保持不变
+        return NULL;
+    if (!GET_MAPPED(HDRP(newptr)))
+        SET_GROWN(HDRP(newptr));
+    size_t copy_size = old_size - DSIZE; // 原来块的负载
     if (size < copy_size)
         copy_size = size;
-    memmove(newptr, temp, copy_size);
+    memcpy(newptr, ptr, copy_size);
+    release(ptr); // 复制完再释放，新块不会和它重叠
     return newptr;
 }
 
@@ -366,17 +1255,194 @@ void *mm_realloc1(void *ptr, size_t size)
     return newptr;
 }
 
+/*
+ * map_block - Serve a large request from a dedicated mapping. The block
+ *     has a header with the MAPPED bit set and the mapping length as its
+ *     size, but no footer since it never takes part in coalescing.
+ */
+static void *map_block(size_t size)
+{
+    size_t pagesize = mem_pagesize();
+    size_t len = (size + DSIZE + pagesize - 1) / pagesize * pagesize;
+    char *base;
+
+    if (len > (size_t)(~0x7u))
+        return NULL;
+    if ((long)(base = mem_map(len)) == -1)
+        return NULL;
+    PUT(base, 0);                              /* Alignment padding */
+    PUT(base + WSIZE, PACK(len, 0x2 | 0x1));   /* Mapped block header */
+    mapped_bytes += len;
+    placed_zero = 1;                           /* New pages read as zero */
+    return base + DSIZE;
+}
+
+/*
+ * remap_block - Resize a mapped block with mremap, so the payload is
+ *     moved by remapping its pages rather than by copying.
+ */
+static void *remap_block(void *bp, size_t size)
+{
+    size_t pagesize = mem_pagesize();
+    size_t len = (size + DSIZE + pagesize - 1) / pagesize * pagesize;
+    char *base;
+
+    if (len == GET_SIZE(HDRP(bp)))
+        return bp;
+    if (len > (size_t)(~0x7u))
+        return NULL;
+    if ((long)(base = mem_remap((char *)bp - DSIZE, len)) == -1)
+        return NULL;
+    mapped_bytes += len - GET_SIZE(base + WSIZE); // 头部还是旧的大小
+    PUT(base + WSIZE, PACK(len, 0x2 | 0x1));
+    return base + DSIZE;
+}
+
+/*
+ * unmap_block - Give a mapped block back to the kernel.
+ */
+static void unmap_block(void *bp)
+{
+    mapped_bytes -= GET_SIZE(HDRP(bp));
+    mem_unmap((char *)bp - DSIZE);
+}
+
+/*
+ * defer_free - Park a small block on the quick list for its exact size.
+ *     The block keeps its allocated header, so neighbours never merge
+ *     with it until merge_deferred runs. Returns 0 if bp is too big, or
+ *     if it lies just below a block growing at the top of the heap: that
+ *     one must merge now, or the next malloc of its size takes it again
+ *     and the growing block can never slide down into the space below.
+ */
+static int defer_free(void *bp)
+{
+    size_t size = GET_SIZE(HDRP(bp));
+
+    if (size > QUICK_MAX)
+        return 0;
+    if (GET_GROWN(HDRP(NEXT_BLKP(bp))) && at_top(NEXT_BLKP(bp)))
+        return 0;
+    PUT_INT(QNEXT(bp), quick[size / DSIZE]);
+    quick[size / DSIZE] = (int)((char *)bp - root);
+    deferred_bytes += size;
+    if (deferred_bytes >= DEFER_LIMIT)
+        merge_deferred();
+    return 1;
+}
+
+/*
+ * merge_deferred - Batch pass: free and coalesce every parked block.
+ */
+static void merge_deferred(void)
+{
+    int i;
+    char *bp;
+
+    batch_passes++;
+    for (i = 0; i < QUICK_LISTS; i++)
+    {
+        while (quick[i] != 0)
+        {
+            bp = root + quick[i];
+            quick[i] = GET_INT(QNEXT(bp));
+            release(bp);
+            batch_merges++;
+        }
+    }
+    deferred_bytes = 0;
+}
+
+/*
+ * mm_stats - Fill in st from counters that the allocation paths keep up
+ *     to date, without walking the heap. Every heap byte outside the
+ *     mm_init prologue is in some block: allocated, parked on a quick
+ *     list, or free. Parked blocks count with the size of their quick
+ *     list, so the slack of blocks parked by mm_free_sized shows up as
+ *     allocated. With -DDEBUG the free counters are checked by a walk.
+ */
+void mm_stats(struct mm_stats *st)
+{
+#ifdef DEBUG
+    size_t bytes = 0, blocks = 0;
+    char *bp;
+
+    for (bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+        if (!GET_ALLOC(HDRP(bp)))
+        {
+            bytes += GET_SIZE(HDRP(bp));
+            blocks++;
+        }
+    if (bytes != free_bytes || blocks != free_blocks)
+    {
+        fprintf(stderr, "mm_stats: %zu free bytes in %zu blocks, counted %zu in %zu\n",
+                bytes, blocks, free_bytes, free_blocks);
+        abort();
+    }
+#endif
+    st->heap_bytes = sbrk_bytes;
+    st->sbrk_calls = sbrk_calls;
+    st->mapped_bytes = mapped_bytes;
+    st->free_bytes = free_bytes;
+    st->free_blocks = free_blocks;
+    memcpy(st->free_band, free_band, sizeof(free_band));
+    st->deferred_bytes = deferred_bytes;
+    st->alloc_bytes = sbrk_bytes - 4 * WSIZE - free_bytes - deferred_bytes +
+                      mapped_bytes;
+}
+
+/*
+ * mm_search_stats - Report the free-list search cost since mm_init.
+ */
+void mm_search_stats(struct mm_search *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->searches = searches;
+    st->nodes = search_nodes;
+    memcpy(st->node_hist, node_hist, sizeof(node_hist));
+    st->buckets = searches;
+    st->bucket_hist[1] = searches;
+    st->free_blocks = free_blocks;
+}
+
+/*
+ * mm_print_stats - Report what deferred coalescing did on this run.
+ */
+void mm_print_stats(void)
+{
+    int i;
+
+    printf("Deferred coalescing: %lu merge/split pairs avoided, "
+           "%lu batch passes merged %lu blocks\n",
+           quick_hits, batch_passes, batch_merges);
+    printf("Known-zero calloc: %lu of %lu bytes needed no memset\n",
+           calloc_saved, calloc_bytes);
+    printf("Size rounding: %lu mallocs rounded up;", rounded);
+    for (i = 0; i < ROUND_CLASSES; i++)
+        if (round_to[i] != 0)
+            printf(" %d->%d", i * DSIZE, round_to[i]);
+    printf("\n");
+}
+
 static void *find_fit(size_t asize)
 {
     // return first_fit(asize);
     // return next_fit(asize);
-    return best_fit(asize);
+    void *bp;
+
+    PHASE_ENTER(PH_FIT);
+    bp = best_fit(asize);
+    PHASE_EXIT(PH_FIT);
+    return bp;
 }
 
 static void *first_fit(size_t asize)
 {
+    size_t nodes = 0;
+
     if (GET_INT(root) == 0)
     {
+        count_search(0);
         return NULL;
     }
 
@@ -384,44 +1450,61 @@ static void *first_fit(size_t asize)
 
     while (GET_SIZE(HDRP(bp)) != 0)
     {
+        nodes++;
         if (GET_SIZE(HDRP(bp)) >= asize)
         {
+            count_search(nodes);
             return bp;
         }
         if (GET_INT(NEXT(bp)) == 0)
         {
-            return NULL;
+            break;
         }
         bp = bp + GET_INT(NEXT(bp));
     }
+    count_search(nodes);
     return NULL;
 }
 
 static void *best_fit(size_t asize)
 {
+    size_t nodes = 0;
+
+    near_size = near_count = 0;
     if (GET_INT(root) == 0)
     {
+        count_search(0);
         return NULL;
     }
     char *bp = RT_NEXT_FREEbp;
     char *best_bp = NULL;
     size_t min_size = 0;
-    while (GET_SIZE(HDRP(bp)) != 0)
+    size_t size;
+    while ((size = GET_SIZE(HDRP(bp))) != 0)
     {
-        if (GET_SIZE(HDRP(bp)) >= asize)
+        nodes++;
+        if (size >= asize)
         {
-            if (min_size == 0 || GET_SIZE(HDRP(bp)) < min_size)
+            if (min_size == 0 || size < min_size)
             {
-                min_size = GET_SIZE(HDRP(bp));
+                min_size = size;
                 best_bp = bp;
             }
         }
+        else if (size > near_size) // 记录差一点就够大的空闲块，供 learn_rounding 使用
+        {
+            near_size = size;
+            near_count = 1;
+        }
+        else if (size == near_size)
+            near_count++;
         if (GET_INT(NEXT(bp)) == 0)
         {
             break;
         }
         bp = bp + GET_INT(NEXT(bp));
     }
+    count_search(nodes);
     return best_bp;
 }
 
@@ -433,6 +1516,12 @@ static void fix_ptr(void *bp)
         return;
     }
 
+    PHASE_ENTER(PH_LIST);
+    size_t size = GET_SIZE(HDRP(bp));
+    free_bytes -= size;
+    free_blocks--;
+    free_band[size_band(size)]--;
+
     int prev_val = GET_INT(PREV(bp));
     int next_val = GET_INT(NEXT(bp));
 
@@ -466,10 +1555,17 @@ static void fix_ptr(void *bp)
             PUT_INT(NEXT(prev), 0);
         }
     }
+    PHASE_EXIT(PH_LIST);
 }
 
 static void make_LIFO(char *bp)
 {
+    PHASE_ENTER(PH_LIST);
+    size_t size = GET_SIZE(HDRP(bp));
+    free_bytes += size;
+    free_blocks++;
+    free_band[size_band(size)]++;
+
     if (GET_INT(root) != 0) // 有后续空节点
     {
         char *old_head = RT_NEXT_FREEbp;
@@ -485,6 +1581,31 @@ static void make_LIFO(char *bp)
         PUT_INT(PREV(bp), 0);        // 新的头节点的前驱指向root
         PUT_INT(NEXT(bp), 0);        // 新的头节点的后继指向0
     }
+    PHASE_EXIT(PH_LIST);
+}
+
+/*
+ * size_band - The mm_stats band of a free block: band i holds blocks of
+ *     16 << 2i up to 64 << 2i bytes, and the last band everything larger.
+ */
+static int size_band(size_t size)
+{
+    int band = (31 - __builtin_clz((unsigned int)size) - 4) / 2;
+
+    return band < MM_STAT_BANDS ? band : MM_STAT_BANDS - 1;
+}
+
+/*
+ * count_search - Record a free-list search that visited nodes blocks.
+ *     There is a single free list, so every search visits one bucket.
+ */
+static void count_search(size_t nodes)
+{
+    int band = nodes == 0 ? 0 : (int)(8 * sizeof(long)) - __builtin_clzl(nodes);
+
+    searches++;
+    search_nodes += nodes;
+    node_hist[band < MM_SEARCH_BANDS ? band : MM_SEARCH_BANDS - 1]++;
 }
 
 static void print_list()
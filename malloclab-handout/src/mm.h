@@ -5,6 +5,77 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 
+/*
+ * Optional extensions. Not every mm-*.c package provides these, so
+ * they are declared weak: an unresolved one is a null pointer, and the
+ * driver checks for that before calling it.
+ */
+#define MM_OPTIONAL __attribute__((weak))
+
+extern void mm_print_stats(void) MM_OPTIONAL; /* per-trace stats for -V */
+
+/* Allocate n blocks of size bytes into ptrs; returns how many succeeded */
+extern size_t mm_malloc_batch(size_t size, size_t n, void **ptrs) MM_OPTIONAL;
+/* Free the n blocks in ptrs (NULLs are skipped); may reorder ptrs */
+extern void mm_free_batch(void **ptrs, size_t n) MM_OPTIONAL;
+/* mm_free for a block last allocated or reallocated with size bytes */
+extern void mm_free_sized(void *ptr, size_t size) MM_OPTIONAL;
+/* Allocate size bytes at a multiple of align (a power of two) */
+extern void *mm_memalign(size_t align, size_t size) MM_OPTIONAL;
+extern void *mm_aligned_alloc(size_t align, size_t size) MM_OPTIONAL;
+/* Allocate zeroed memory for nmemb elements of size bytes each */
+extern void *mm_calloc(size_t nmemb, size_t size) MM_OPTIONAL;
+/* Bytes the caller may use at ptr: at least the size it asked for */
+extern size_t mm_usable_size(void *ptr) MM_OPTIONAL;
+
+/*
+ * Heap statistics, kept up to date by the package so that reading them
+ * doesn't walk the heap. Sizes are block sizes, headers included.
+ */
+#define MM_STAT_BANDS 8
+struct mm_stats {
+    size_t heap_bytes;      /* bytes obtained with mem_sbrk */
+    size_t sbrk_calls;      /* number of mem_sbrk calls */
+    size_t mapped_bytes;    /* bytes in blocks with a mapping of their own */
+    size_t alloc_bytes;     /* bytes in allocated blocks, mapped ones included */
+    size_t deferred_bytes;  /* bytes freed but not yet coalesced */
+    size_t free_bytes;      /* bytes in free blocks */
+    size_t free_blocks;     /* number of free blocks */
+    size_t free_band[MM_STAT_BANDS]; /* free blocks of 16<<2i to 64<<2i bytes;
+                                        the last band has all larger ones */
+};
+extern void mm_stats(struct mm_stats *st) MM_OPTIONAL;
+
+/*
+ * Free-list search cost since mm_init, counted in nodes and size
+ * classes (buckets) visited rather than time. Band 0 of a histogram
+ * counts searches that visited nothing, band i > 0 those that visited
+ * 2^(i-1) to 2^i - 1; the last band has all longer ones.
+ */
+#define MM_SEARCH_BANDS 16
+struct mm_search {
+    size_t searches;        /* free-list searches */
+    size_t nodes;           /* free blocks visited, in all */
+    size_t buckets;         /* size classes visited, in all */
+    size_t node_hist[MM_SEARCH_BANDS];   /* searches by free blocks visited */
+    size_t bucket_hist[MM_SEARCH_BANDS]; /* searches by size classes visited */
+    size_t free_blocks;     /* blocks on the free lists now */
+};
+extern void mm_search_stats(struct mm_search *st) MM_OPTIONAL;
+
+/*
+ * Movable blocks named by handles (mm-compact.c). mm_pin returns the
+ * payload address and keeps the block in place until mm_unpin;
+ * mm_compact may move any block that isn't pinned.
+ */
+typedef struct mm_handle *mm_handle_t;
+extern mm_handle_t mm_halloc(size_t size) MM_OPTIONAL;
+extern int mm_hrealloc(mm_handle_t h, size_t size) MM_OPTIONAL; /* 0 or -1 */
+extern void mm_hfree(mm_handle_t h) MM_OPTIONAL;
+extern void *mm_pin(mm_handle_t h) MM_OPTIONAL;
+extern void mm_unpin(mm_handle_t h) MM_OPTIONAL;
+extern size_t mm_compact(void) MM_OPTIONAL; /* returns bytes moved */
+
 
 /* 
  * Students work in teams of one or two.  Teams enter their team name, 
@@ -17,6 +17,7 @@
 
 #include "mm.h"
 #include "memlib.h"
+#include "mmaccess.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -49,17 +50,21 @@ team_t team = {
 /* 双字 */
 #define DSIZE 8
 
-/* 扩展堆时的默认大小 */
+/* 扩展堆时的最小步长, 突发增长时步长翻倍, 最多到 MAXCHUNK */
 #define CHUNKSIZE (1 << 12)
+#define MAXCHUNK (1 << 15)
+/* 两次扩展之间的 malloc 次数少于这个值就算突发增长 */
+#define BURST_ALLOCS 8
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
+#define MIN(x, y) ((x) < (y)? (x) : (y))
 
 /* 设置头部和脚部的值, 块大小+分配位 */
 #define PACK(size, alloc) ((size) | (alloc))
 
 /* 读写指针p的位置 */
-#define GET(p) (*(unsigned int *)(p))
-#define PUT(p, val) ((*(unsigned int *)(p)) = (val))
+#define GET(p) (*(unsigned int *)MMACCESS_READ(p))
+#define PUT(p, val) ((*(unsigned int *)MMACCESS_WRITE(p)) = (val))
 
 /* 从头部或脚部获取大小或分配位 */
 #define GET_SIZE(p) (GET(p) & ~0x7)
@@ -86,9 +91,13 @@ team_t team = {
 #define CLASS_SIZE 20
 /* 总是指向序言块的第二块 */
 static char *heap_list;
+/* 当前扩展步长, malloc 次数, 上次扩展时的 malloc 次数 */
+static size_t chunksize;
+static unsigned long mallocs, mallocs_at_grow;
 
 /************************/
 static void *extend_heap(size_t words);     //扩展堆
+static void *grow_heap(size_t asize);       //按需扩展堆
 static void *coalesce(void *bp);            //合并空闲块
 static void *find_fit(size_t asize);        //找到匹配的块
 static void place(void *bp, size_t asize);  //分割空闲块
@@ -117,6 +126,9 @@ int mm_init(void)
     PUT(heap_list + ((3 + CLASS_SIZE)*WSIZE), PACK(0, 1));         /* 结尾块 */
 
 
+    chunksize = CHUNKSIZE;
+    mallocs = mallocs_at_grow = 0;
+
     /* 扩展空闲空间 */
     if(extend_heap(CHUNKSIZE/WSIZE) == NULL)
         return -1;
@@ -149,6 +161,29 @@ void *extend_heap(size_t words)
 }
 
 
+/*
+ * 按需扩展堆: 堆顶已有空闲块时只扩展差额;
+ * 突发增长时步长翻倍, 增长变慢后再减半
+*/
+static void *grow_heap(size_t asize)
+{
+    char *last_ftr = (char *)mem_heap_hi() + 1 - DSIZE;   /* 最后一块的脚部 */
+    size_t top = GET_ALLOC(last_ftr) ? 0 : GET_SIZE(last_ftr);
+    size_t want = asize;
+
+    if(top >= asize)    /* 堆顶的空闲块已经够大 */
+        return last_ftr + DSIZE - top;
+
+    if(mallocs - mallocs_at_grow < BURST_ALLOCS){
+        chunksize = MIN(2 * chunksize, MAXCHUNK);
+        want = MAX(chunksize, asize);
+    } else if(chunksize > CHUNKSIZE){
+        chunksize /= 2;
+    }
+    mallocs_at_grow = mallocs;
+    return extend_heap(MAX(want - top, 2 * DSIZE) / WSIZE);
+}
+
 /*
  * 合并空闲块
 */
@@ -333,10 +368,10 @@ void *mm_malloc(size_t size)
     //     return (void *)((char *)p + SIZE_T_SIZE);
     // }
     size_t asize;
-    size_t extendsize;
     char *bp;
     if(size == 0)
         return NULL;
+    mallocs++;
     if(size <= DSIZE)
         asize = 2*DSIZE;
     else
@@ -347,8 +382,7 @@ void *mm_malloc(size_t size)
         return bp;
     }
     /* 找不到则扩展堆 */
-    extendsize = MAX(asize, CHUNKSIZE);
-    if((bp = extend_heap(extendsize/WSIZE)) == NULL)
+    if((bp = grow_heap(asize)) == NULL)
         return NULL;
     place(bp, asize);
     return bp;
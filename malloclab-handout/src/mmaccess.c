@@ -0,0 +1,195 @@
+/*
+ * mmaccess.c - Cache model of the metadata accesses of an allocator
+ *
+ * The logged addresses are replayed, in order, through a cache of
+ * MMACCESS_CACHE bytes in sets of MMACCESS_WAYS lines with LRU
+ * replacement; reads and writes both allocate a line. The cache is
+ * cold at mmaccess_start, so a trace's first requests pay compulsory
+ * misses. For every kind of request the model counts the accesses,
+ * the misses and the distinct lines each request touched, which is
+ * what a layout decides: a header and footer on separate lines, or
+ * free list links far from the size they are searched for, show up
+ * as more lines per request before they show up as misses.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "mmaccess.h"
+
+#define SETS (MMACCESS_CACHE / (MMACCESS_WAYS * MMACCESS_LINE))
+#define SEEN_BITS 16                      /* the lines of one request */
+#define SEEN_SIZE (1 << SEEN_BITS)
+#define SEEN_MAX (SEEN_SIZE / 4 * 3)      /* lines counted per request */
+
+/* Counts for one kind of request */
+typedef struct {
+    unsigned long calls;
+    unsigned long refs;   /* logged accesses */
+    unsigned long writes;
+    unsigned long lines;  /* distinct lines, summed over the calls */
+    unsigned long misses;
+} opstats_t;
+
+/* A line touched by the current request; valid if stamp is current */
+typedef struct {
+    unsigned long line;
+    unsigned long stamp;
+} seen_t;
+
+unsigned long mmaccess_ring[MMACCESS_RING];
+int mmaccess_n;
+int mmaccess_on;
+
+static const char *const *names; /* NULL until the driver starts a replay */
+static int nops;
+static opstats_t stats[MMACCESS_OPS];
+static int cur = -1;             /* request being served, -1 if none */
+
+/* Lines of each set, most recently used first; 0 is an empty way,
+   as no metadata lives in the first line of the address space */
+static unsigned long cache[SETS][MMACCESS_WAYS];
+
+static seen_t seen[SEEN_SIZE];
+static unsigned long stamp;      /* one per request */
+static unsigned long nseen;      /* lines of the current request */
+
+/*
+ * lookup - Run one access through the cache; returns 1 on a miss.
+ */
+static int lookup(unsigned long line)
+{
+    unsigned long *set = cache[line % SETS];
+    int i;
+
+    for (i = 0; i < MMACCESS_WAYS - 1 && set[i] != line; i++)
+	;
+    if (set[i] == line) {
+	memmove(set + 1, set, i * sizeof(set[0]));
+	set[0] = line;
+	return 0;
+    }
+    memmove(set + 1, set, (MMACCESS_WAYS - 1) * sizeof(set[0]));
+    set[0] = line;
+    return 1;
+}
+
+/*
+ * touch - Note that the current request touched line; returns 1 the
+ *     first time. Gives up counting beyond SEEN_MAX lines.
+ */
+static int touch(unsigned long line)
+{
+    unsigned long h = (line * 0x9e3779b97f4a7c15UL) >> (64 - SEEN_BITS);
+
+    for (;;) {
+	if (seen[h].stamp != stamp) {
+	    if (nseen == SEEN_MAX)
+		return 0;
+	    seen[h].line = line;
+	    seen[h].stamp = stamp;
+	    nseen++;
+	    return 1;
+	}
+	if (seen[h].line == line)
+	    return 0;
+	h = (h + 1) & (SEEN_SIZE - 1);
+    }
+}
+
+/*
+ * mmaccess_drain - Run the ring through the model and empty it. The
+ *     accesses count for the current request, or for none before the
+ *     first mmaccess_op.
+ */
+void mmaccess_drain(void)
+{
+    opstats_t *s = cur >= 0 ? &stats[cur] : NULL;
+    unsigned long line;
+    int i, miss;
+
+    for (i = 0; i < mmaccess_n; i++) {
+	line = mmaccess_ring[i] / MMACCESS_LINE;
+	miss = lookup(line);
+	if (s == NULL)
+	    continue;
+	s->refs++;
+	s->writes += mmaccess_ring[i] & 1;
+	s->misses += miss;
+	s->lines += touch(line);
+    }
+    mmaccess_n = 0;
+}
+
+/*
+ * mmaccess_start - Log from now on, for the requests named 0..n-1,
+ *     starting with a cold cache and zero counts.
+ */
+void mmaccess_start(const char *const *n_names, int n)
+{
+    names = n_names;
+    nops = n < MMACCESS_OPS ? n : MMACCESS_OPS;
+    memset(stats, 0, sizeof(stats));
+    memset(cache, 0, sizeof(cache));
+    cur = -1;
+    stamp++;
+    nseen = 0;
+    mmaccess_n = 0;
+    mmaccess_on = 1;
+}
+
+void mmaccess_op(int op)
+{
+    if (!mmaccess_on)
+	return;
+    mmaccess_drain();
+    cur = op >= 0 && op < nops ? op : -1;
+    if (cur >= 0)
+	stats[cur].calls++;
+    stamp++;
+    nseen = 0;
+}
+
+void mmaccess_stop(void)
+{
+    if (!mmaccess_on)
+	return;
+    mmaccess_drain();
+    mmaccess_on = 0;
+    cur = -1;
+}
+
+/*
+ * mmaccess_print - Print the accesses, lines touched and misses per
+ *     request of every kind of request that was served.
+ */
+void mmaccess_print(void)
+{
+    opstats_t total;
+    opstats_t *s;
+    int i;
+
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < nops; i++) {
+	total.calls += stats[i].calls;
+	total.refs += stats[i].refs;
+	total.writes += stats[i].writes;
+	total.lines += stats[i].lines;
+	total.misses += stats[i].misses;
+    }
+    if (names == NULL || total.refs == 0)
+	return;
+    printf("Metadata accesses per request (%d KB, %d-way, %d-byte lines):\n",
+	   MMACCESS_CACHE / 1024, MMACCESS_WAYS, MMACCESS_LINE);
+    printf("  %-14s %10s %10s %10s %10s %10s %7s\n", "request", "calls",
+	   "refs", "writes", "lines", "misses", "miss%");
+    for (i = 0; i <= nops; i++) {
+	s = i < nops ? &stats[i] : &total;
+	if (s->calls == 0)
+	    continue;
+	printf("  %-14s %10lu %10.1f %10.1f %10.1f %10.2f %6.2f%%\n",
+	       i < nops ? names[i] : "all", s->calls,
+	       (double)s->refs / s->calls, (double)s->writes / s->calls,
+	       (double)s->lines / s->calls, (double)s->misses / s->calls,
+	       s->refs ? 100.0 * s->misses / s->refs : 0.0);
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * mmaccess.h - Cache model of the metadata accesses of an allocator
+ *
+ * Compiled in only when the package is built with -DMM_MEMTRACE, e.g.
+ *     make clean; make CFLAGS="-Wall -O2 -g -DMM_MEMTRACE"
+ * A package routes the address of every metadata access through
+ * MMACCESS_READ or MMACCESS_WRITE, in its GET and PUT macros and in
+ * any other macro that reads or writes the heap, such as the free list
+ * links; they log the address in a ring buffer and return it.
+ * Otherwise they return it unchanged and cost nothing. The driver brackets a replay
+ * with mmaccess_start and mmaccess_stop and calls mmaccess_op before
+ * each request; the log goes through a set-associative LRU cache
+ * whenever the ring fills up and at the end of each request.
+ */
+#ifdef MM_MEMTRACE
+#define MMACCESS_READ(p) mmaccess_log((p), 0)
+#define MMACCESS_WRITE(p) mmaccess_log((p), 1)
+#else
+#define MMACCESS_READ(p) ((void *)(p))
+#define MMACCESS_WRITE(p) ((void *)(p))
+#endif
+
+/* The modelled cache; override with -D, e.g. -DMMACCESS_CACHE=65536 */
+#ifndef MMACCESS_CACHE
+#define MMACCESS_CACHE (32 * 1024) /* bytes */
+#endif
+#ifndef MMACCESS_WAYS
+#define MMACCESS_WAYS 8
+#endif
+#ifndef MMACCESS_LINE
+#define MMACCESS_LINE 64           /* bytes, a power of two */
+#endif
+
+#define MMACCESS_RING 4096 /* logged accesses between runs of the model */
+#define MMACCESS_OPS 16    /* kinds of request the driver may name */
+
+/* Fast-path state; only mmaccess.c changes it */
+extern unsigned long mmaccess_ring[]; /* address, plus 1 for a write */
+extern int mmaccess_n;                /* entries in the ring */
+extern int mmaccess_on;               /* between start and stop */
+
+void mmaccess_drain(void);
+
+static inline void *mmaccess_log(void *p, int write)
+{
+    if (mmaccess_on) {
+	if (mmaccess_n == MMACCESS_RING)
+	    mmaccess_drain();
+	mmaccess_ring[mmaccess_n++] = (unsigned long)p | (write != 0);
+    }
+    return p;
+}
+
+void mmaccess_start(const char *const *names, int n); /* cold cache, zero counts */
+void mmaccess_op(int op);  /* the accesses from now on serve a request op */
+void mmaccess_stop(void);
+void mmaccess_print(void); /* prints nothing if no access was logged */
@@ -17,6 +17,8 @@
 
 #include "mm.h"
 #include "memlib.h"
+#include "mmaccess.h"
+#include "mmphase.h"
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -58,7 +60,9 @@ team_t team = {
 /* Basic constants and macros */
 #define WSIZE 4 /* Word and header/footer size (bytes) */
 #define DSIZE 8 /* Double word size (bytes) */
-#define CHUNKSIZE (1<<12) /* Extend heap by this amount (bytes) */
+#define CHUNKSIZE (1<<12) /* Smallest step of the adaptive heap growth (bytes) */
+#define MAXCHUNK (1<<15) /* Largest step of the adaptive heap growth (bytes) */
+#define BURST_ALLOCS 8 /* Fewer mallocs than this between extensions is a burst */
 #define INITCHUNKSIZE (1<<6)
 
 #define MAX(x, y) ((x) > (y)? (x) : (y))
@@ -66,9 +70,9 @@ team_t team = {
 /* Pack a size and allocated bit into a word */
 #define PACK(size, alloc) ((size) | (alloc))
 
-/* Read and write a word at address p */
-#define GET(p) (*(unsigned int *)(p))
-#define PUT(p, val) (*(unsigned int *)(p) = (val))
+/* Read and write a word at address p; logged with -DMM_MEMTRACE */
+#define GET(p) (*(unsigned int *)MMACCESS_READ(p))
+#define PUT(p, val) (*(unsigned int *)MMACCESS_WRITE(p) = (val))
 
 /* Read the size and allocated fields from address p */
 #define GET_SIZE(p) (GET(p) & ~0x7)
@@ -86,13 +90,15 @@ team_t team = {
 #define PRED_PTR(ptr) ((char *)(ptr))
 #define SUCC_PTR(ptr) ((char *)(ptr) + WSIZE)
 
-#define PRED(ptr) (*(char **)(ptr))
-#define SUCC(ptr) (*(char **)(SUCC_PTR(ptr)))
+/* Read and write the links of a free block; logged like GET and PUT */
+#define PRED(ptr) (*(char **)MMACCESS_READ(ptr))
+#define SUCC(ptr) (*(char **)MMACCESS_READ(SUCC_PTR(ptr)))
 
 
-#define SET_PTR(p, ptr) (*(unsigned int *)(p) = (unsigned int)(ptr))
+#define SET_PTR(p, ptr) (*(unsigned int *)MMACCESS_WRITE(p) = (unsigned int)(ptr))
 
 static void *extend_heap(size_t words);
+static void *grow_heap(size_t asize);
 static void *place(void *bp, size_t asize);
 static void *coalesce(void *bp);
 static void insert_node(void *bp, size_t size);
@@ -100,10 +106,23 @@ static void delete_node(void *bp);
 static size_t get_asize(size_t size);
 static void *realloc_coalesce(void *bp,size_t newSize,int *isNextFree);
 static void realloc_place(void *bp,size_t asize);
+static void count_search(size_t nodes, size_t buckets);
 void checkheap(int verbose);
 void mm_checkheap(int verbose);
 void *seg_free_lists[LISTMAX];
 char *heap_listp;
+static size_t chunksize; /* Current step of the adaptive heap growth */
+static unsigned long mallocs, mallocs_at_grow; /* mm_malloc calls, total and at last growth */
+
+/* Counters behind mm_search_stats */
+static size_t searches, search_nodes, search_buckets;
+static size_t node_hist[MM_SEARCH_BANDS], bucket_hist[MM_SEARCH_BANDS];
+static size_t free_blocks; /* Blocks on the seg_free_lists */
+
+/* Phases timed when built with -DMM_PHASES, see mmphase.h */
+enum { PH_FIT, PH_PLACE, PH_COALESCE, PH_LIST, PH_EXTEND, NPHASES };
+static const char *const phase_names[NPHASES] = {
+    "list scan", "place", "coalesce", "insert/delete_node", "extend_heap"};
 
 static void *extend_heap(size_t words)
 {
@@ -111,9 +130,12 @@ static void *extend_heap(size_t words)
     size_t size;
 
     /* Allocate an even number of words to maintain alignment */
+    PHASE_ENTER(PH_EXTEND);
     size = (words % 2) ? (words+1) * WSIZE : words * WSIZE;
-    if ((long)(bp = mem_sbrk(size)) == -1)
+    if ((long)(bp = mem_sbrk(size)) == -1) {
+        PHASE_EXIT(PH_EXTEND);
         return NULL;
+    }
 
     /* Initialize free block header/footer and the epilogue header */
     
@@ -122,7 +144,34 @@ static void *extend_heap(size_t words)
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
 
     /* Coalesce if the previous block was free include insert*/
-    return coalesce(bp);
+    bp = coalesce(bp);
+    PHASE_EXIT(PH_EXTEND);
+    return bp;
+}
+
+/*
+ * grow_heap - Extend the heap so that a block of asize bytes fits at its
+ *     end, requesting only the deficit over a free block at the top. The
+ *     step doubles while the heap grows in bursts and shrinks back once
+ *     growth slows down.
+ */
+static void *grow_heap(size_t asize)
+{
+    char *last_ftr = (char *)mem_heap_hi() + 1 - DSIZE;
+    size_t top = GET_ALLOC(last_ftr) ? 0 : GET_SIZE(last_ftr);
+    size_t want = asize;
+
+    if (top >= asize) /* the free block at the top already fits */
+        return last_ftr + DSIZE - top;
+
+    if (mallocs - mallocs_at_grow < BURST_ALLOCS) {
+        chunksize = MIN(2 * chunksize, MAXCHUNK);
+        want = MAX(chunksize, asize);
+    } else if (chunksize > CHUNKSIZE) {
+        chunksize /= 2;
+    }
+    mallocs_at_grow = mallocs;
+    return extend_heap(MAX(want - top, 2 * DSIZE) / WSIZE);
 }
 /* 
  * mm_init - initialize the malloc package.
@@ -134,6 +183,12 @@ int mm_init(void)//done
     for (i = 0; i < LISTMAX; i++) {
         seg_free_lists[i] = NULL;
     }
+    chunksize = CHUNKSIZE;
+    mallocs = mallocs_at_grow = 0;
+    searches = search_nodes = search_buckets = free_blocks = 0;
+    memset(node_hist, 0, sizeof(node_hist));
+    memset(bucket_hist, 0, sizeof(bucket_hist));
+    PHASE_INIT(phase_names, NPHASES);
     /* Create the initial empty heap */
     if ((heap_listp = mem_sbrk(4*WSIZE)) == (void *)-1)
         return -1;
@@ -153,6 +208,7 @@ int mm_init(void)//done
 static void *place(void *bp, size_t asize)//done
 {
     size_t size = GET_SIZE(HDRP(bp));
+    PHASE_ENTER(PH_PLACE);
     delete_node(bp);
     if ((size - asize) < (2*DSIZE)) {
         PUT(HDRP(bp),PACK(size,1));
@@ -163,6 +219,7 @@ static void *place(void *bp, size_t asize)//done
         PUT(HDRP(NEXT_BLKP(bp)),PACK(asize,1));
         PUT(FTRP(NEXT_BLKP(bp)),PACK(asize,1));
         insert_node(bp,size - asize);
+        PHASE_EXIT(PH_PLACE);
         return NEXT_BLKP(bp);
     } else {
         PUT(HDRP(bp),PACK(asize,1));
@@ -171,12 +228,15 @@ static void *place(void *bp, size_t asize)//done
         PUT(FTRP(NEXT_BLKP(bp)),PACK(size - asize,0));
         insert_node(NEXT_BLKP(bp),size - asize);
     }
+    PHASE_EXIT(PH_PLACE);
     return bp;
 }
 static void insert_node(void *bp, size_t size)
 {
     int tar = 0;
     size_t j;
+    PHASE_ENTER(PH_LIST);
+    free_blocks++;
     for (j = size; (j > 1) && (tar < LISTMAX - 1); ) {
         j >>= 1;
         tar++;
@@ -206,11 +266,14 @@ static void insert_node(void *bp, size_t size)
         SET_PTR(PRED_PTR(i), bp);
         SET_PTR(SUCC_PTR(pre), bp);
     }
+    PHASE_EXIT(PH_LIST);
 }
 static void delete_node(void *bp)//done
 {
     size_t size = GET_SIZE(HDRP(bp)), j;
     int tar = 0;
+    PHASE_ENTER(PH_LIST);
+    free_blocks--;
     for (j = size; (j > 1) && (tar < LISTMAX - 1); j >>= 1) {
         tar++;
     }
@@ -225,6 +288,7 @@ static void delete_node(void *bp)//done
         SET_PTR(SUCC_PTR(PRED(bp)), SUCC(bp));
         SET_PTR(PRED_PTR(SUCC(bp)), PRED(bp));
     }
+    PHASE_EXIT(PH_LIST);
 }
 
 /* 
@@ -234,33 +298,39 @@ static void delete_node(void *bp)//done
 void *mm_malloc(size_t size)
 {
     size_t asize, search; /* Adjusted block size */
-    size_t extendsize; /* Amount to extend heap if no fit */
+    size_t nodes = 0, buckets = 0;
     char *bp = NULL;
     
     /* Ignore spurious requests */
     if (size == 0)
         return NULL;
+    mallocs++;
     
     /* Adjust block size to include overhead and alignment reqs. */
     asize = get_asize(size);
     search = asize;
     int target;
+    PHASE_ENTER(PH_FIT);
     for (target = 0; target < LISTMAX; target++, search >>= 1) {
         /* find target seg_free_list*/
-        if ((search > 1) || (seg_free_lists[target] == NULL)) continue;
+        if (search > 1) continue;
+        buckets++;
+        if (seg_free_lists[target] == NULL) continue;
         char *i = seg_free_lists[target];
         for(;i != NULL;i = SUCC(i))
         {
+            nodes++;
             if (GET_SIZE(HDRP(i)) < asize) continue;
             bp = i;
             break;
         }
         if (bp != NULL) break;
     }
+    count_search(nodes, buckets);
+    PHASE_EXIT(PH_FIT);
     if (bp == NULL) {
         /* No fit found. Get more memory and place the block */
-        extendsize = MAX(asize,CHUNKSIZE);
-        if ((bp = extend_heap(extendsize/WSIZE)) == NULL)
+        if ((bp = grow_heap(asize)) == NULL)
             return NULL;
     }
     bp = place(bp, asize);
@@ -274,6 +344,7 @@ static void *coalesce(void *bp)
     size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
     size_t size = GET_SIZE(HDRP(bp));
     
+    PHASE_ENTER(PH_COALESCE);
     if (prev_alloc && !next_alloc) { /* Case 2 */
         size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
         delete_node(NEXT_BLKP(bp));
@@ -299,6 +370,7 @@ static void *coalesce(void *bp)
         bp = PREV_BLKP(bp);
     }
     insert_node(bp,size);
+    PHASE_EXIT(PH_COALESCE);
     return bp;
 }
 /*
@@ -438,6 +510,40 @@ static void realloc_place(void *bp,size_t asize)
 
 /* below code if for check heap invarints */
 
+/* search_band - The mm_search histogram band of n visits */
+static int search_band(size_t n)
+{
+    int band = n == 0 ? 0 : (int)(8 * sizeof(long)) - __builtin_clzl(n);
+
+    return band < MM_SEARCH_BANDS ? band : MM_SEARCH_BANDS - 1;
+}
+
+/*
+ * count_search - Record a search of the seg_free_lists that visited
+ *     nodes free blocks in buckets size classes.
+ */
+static void count_search(size_t nodes, size_t buckets)
+{
+    searches++;
+    search_nodes += nodes;
+    search_buckets += buckets;
+    node_hist[search_band(nodes)]++;
+    bucket_hist[search_band(buckets)]++;
+}
+
+/*
+ * mm_search_stats - Report the free-list search cost since mm_init.
+ */
+void mm_search_stats(struct mm_search *st)
+{
+    st->searches = searches;
+    st->nodes = search_nodes;
+    st->buckets = search_buckets;
+    memcpy(st->node_hist, node_hist, sizeof(node_hist));
+    memcpy(st->bucket_hist, bucket_hist, sizeof(bucket_hist));
+    st->free_blocks = free_blocks;
+}
+
 static void printblock(void *bp) 
 {
     long int hsize, halloc, fsize, falloc;
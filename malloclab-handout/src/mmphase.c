@@ -0,0 +1,104 @@
+/*
+ * mmphase.c - Cycle accounting for the internal phases of an allocator
+ *
+ * The cycle counter of clock.c is read on every PHASE_ENTER and
+ * PHASE_EXIT. A stack of the open phases remembers when each was
+ * entered and how many cycles its nested phases took, and on exit the
+ * difference is added to the phase's own ("self") cycles. Each counter
+ * read costs a few dozen cycles, which a phase's self time includes,
+ * so short phases that are called very often look somewhat slower
+ * than they are.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "clock.h"
+#include "mmphase.h"
+
+/* One open phase */
+typedef struct {
+    int ph;
+    unsigned long long start;  /* counter at PHASE_ENTER */
+    unsigned long long nested; /* cycles in the phases it called */
+} frame_t;
+
+static const char *const *names; /* NULL until a package names its phases */
+static int nphases;
+static unsigned long calls[MMPHASE_MAX];
+static unsigned long long cycles[MMPHASE_MAX]; /* self cycles */
+static frame_t stack[MMPHASE_DEPTH];
+static int depth;                 /* open phases, even if not all are timed */
+
+static unsigned long long now(void)
+{
+    unsigned hi, lo;
+
+    access_counter(&hi, &lo);
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+/*
+ * mmphase_init - Name the phases 0..n-1 and zero their counts. Called
+ *     from mm_init, so the counts cover the run since the last mm_init.
+ */
+void mmphase_init(const char *const *n_names, int n)
+{
+    names = n_names;
+    nphases = n < MMPHASE_MAX ? n : MMPHASE_MAX;
+    memset(calls, 0, sizeof(calls));
+    memset(cycles, 0, sizeof(cycles));
+    depth = 0;
+}
+
+void mmphase_enter(int ph)
+{
+    if (depth < MMPHASE_DEPTH) {
+	stack[depth].ph = ph;
+	stack[depth].nested = 0;
+	stack[depth].start = now();
+    }
+    depth++;
+}
+
+void mmphase_exit(int ph)
+{
+    unsigned long long elapsed;
+    frame_t *f;
+
+    if (depth == 0)
+	return;
+    if (--depth >= MMPHASE_DEPTH)
+	return;
+    f = &stack[depth];
+    elapsed = now() - f->start;
+    if (f->ph != ph || ph < 0 || ph >= nphases) {
+	fprintf(stderr, "mmphase: exit from phase %d inside phase %d\n",
+		ph, f->ph);
+	return;
+    }
+    calls[ph]++;
+    cycles[ph] += elapsed > f->nested ? elapsed - f->nested : 0;
+    if (depth > 0)
+	stack[depth - 1].nested += elapsed;
+}
+
+/*
+ * mmphase_print - Print the calls and self cycles of every phase.
+ */
+void mmphase_print(void)
+{
+    unsigned long long total = 0;
+    int i;
+
+    if (names == NULL)
+	return;
+    for (i = 0; i < nphases; i++)
+	total += cycles[i];
+    printf("Phase cycles (self, nested phases excluded):\n");
+    printf("  %-20s %10s %14s %10s %6s\n",
+	   "phase", "calls", "cycles", "cyc/call", "share");
+    for (i = 0; i < nphases; i++)
+	printf("  %-20s %10lu %14llu %10.1f %5.1f%%\n", names[i], calls[i],
+	       cycles[i], calls[i] ? (double)cycles[i] / calls[i] : 0.0,
+	       total ? 100.0 * cycles[i] / total : 0.0);
+}
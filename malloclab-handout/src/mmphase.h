@@ -0,0 +1,28 @@
+/*
+ * mmphase.h - Cycle accounting for the internal phases of an allocator
+ *
+ * Compiled in only when the package is built with -DMM_PHASES, e.g.
+ *     make clean; make CFLAGS="-Wall -O2 -g -DMM_PHASES"
+ * Otherwise the macros expand to nothing and cost nothing. A package
+ * names its phases in mm_init with PHASE_INIT and brackets each phase
+ * with PHASE_ENTER and PHASE_EXIT. Phases may nest; the cycles of a
+ * nested phase are charged to it and not to the phase it was called
+ * from, so the totals of all phases add up.
+ */
+#ifdef MM_PHASES
+#define PHASE_INIT(names, n) mmphase_init((names), (n))
+#define PHASE_ENTER(ph) mmphase_enter(ph)
+#define PHASE_EXIT(ph) mmphase_exit(ph)
+#else
+#define PHASE_INIT(names, n) ((void)(names), (void)(n))
+#define PHASE_ENTER(ph) ((void)0)
+#define PHASE_EXIT(ph) ((void)0)
+#endif
+
+#define MMPHASE_MAX 16   /* phases a package may name */
+#define MMPHASE_DEPTH 16 /* deepest nesting that is timed */
+
+void mmphase_init(const char *const *names, int n); /* also resets the counts */
+void mmphase_enter(int ph);
+void mmphase_exit(int ph);
+void mmphase_print(void); /* prints nothing if no phases were named */
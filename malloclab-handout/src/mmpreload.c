@@ -0,0 +1,368 @@
+/*
+ * mmpreload.c - Run unmodified programs on an mm package
+ *
+ * Built as libmm.so, from the package in mm.c or another one named
+ * with MM=, and preloaded:
+ *
+ *   unix> LD_PRELOAD=./libmm.so app ...
+ *
+ * malloc, free, realloc, calloc and the aligned and introspection
+ * calls are served by the package through the mm.h API, on a memlib
+ * built with MEM_PRELOAD, where the simulated heap is the real memory
+ * of the process. Packages are not thread safe, so one mutex is held
+ * across every call; it is also taken around fork, so that the child
+ * never inherits a heap in the middle of an update.
+ *
+ * Environment:
+ *   MMLIB_HEAP   budget of the heap and the mappings, in bytes or with
+ *                a K, M or G suffix (default 1G). The packages keep
+ *                32-bit sizes and offsets, so keep it below 2G.
+ *   MMLIB_ALIGN  payload alignment (default 8, what the packages give).
+ *                Some programs count on the 16 bytes of glibc; set
+ *                MMLIB_ALIGN=16 to serve them through mm_memalign.
+ *   MMLIB_PROF_FILE  profile the heap with mmprof and write the profile
+ *                here at exit (default: no profiling).
+ *   MMLIB_PROF_RATE  mean bytes between profile samples, with the same
+ *                suffixes as MMLIB_HEAP (default 512K).
+ *
+ * The optional API is used when the package has it: mm_calloc,
+ * mm_memalign and mm_usable_size. Without mm_memalign, alignments
+ * above 8 fail with ENOMEM; without mm_usable_size,
+ * malloc_usable_size returns 0. free ignores pointers that are not in
+ * the heap, like the few blocks the dynamic loader allocates before
+ * the library is in place; realloc hands them to the C library. A package that prints while it holds the
+ * lock calls back into malloc through stdio; such calls go to the C
+ * library's allocator through its __libc_* entry points.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "mmprof.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_memalign(size_t align, size_t size);
+
+#define DEFAULT_HEAP (1UL << 30) /* default MMLIB_HEAP */
+#define MM_ALIGN 8               /* alignment of every package */
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int ready;                /* mem_init and mm_init have run */
+static size_t heap_max;          /* MMLIB_HEAP */
+static size_t min_align;         /* MMLIB_ALIGN */
+static char *prof_file;          /* MMLIB_PROF_FILE, or NULL */
+static __thread int inside;      /* this thread holds the lock */
+
+static int enter(void);
+static void leave(void);
+static void lock_all(void);
+static void setup(void);
+static void prof_dump(void);
+static size_t env_size(const char *name, size_t dflt);
+static int ours(void *ptr);
+static void *alloc(size_t size, size_t align);
+static void die(const char *msg);
+
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (!enter())
+	return __libc_malloc(size);
+    p = alloc(size, min_align);
+    MMPROF_MALLOC(p, size);
+    leave();
+    return p;
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL)
+	return;
+    if (!enter()) {
+	__libc_free(ptr);
+	return;
+    }
+    if (ours(ptr)) {
+	MMPROF_FREE(ptr);
+	mm_free(ptr);
+    }
+    leave();
+}
+
+/*
+ * realloc - mm_realloc, except that a size of 0 frees the block as
+ *     glibc does. With MMLIB_ALIGN above 8 a block that the package
+ *     moved to a less aligned address is moved once more, if there is
+ *     room. A block that is not in the heap came from the C library,
+ *     which resizes it.
+ */
+void *realloc(void *ptr, size_t size)
+{
+    void *p, *q;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if (size == 0) {
+	free(ptr);
+	return NULL;
+    }
+    if (!enter())
+	return __libc_realloc(ptr, size);
+    if (!ours(ptr)) {
+	leave();
+	return __libc_realloc(ptr, size);
+    }
+    if (size > heap_max)
+	p = NULL;
+    else if ((p = mm_realloc(ptr, size)) != NULL &&
+	     ((unsigned long)p & (min_align - 1)) != 0) {
+	if ((q = alloc(size, min_align)) != NULL) {
+	    memcpy(q, p, size);
+	    mm_free(p);
+	    p = q;
+	}
+    }
+    if (p != NULL) {
+	MMPROF_FREE(ptr);
+	MMPROF_MALLOC(p, size);
+    }
+    leave();
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+void *reallocarray(void *ptr, size_t nmemb, size_t size)
+{
+    if (size != 0 && nmemb > (size_t)-1 / size) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    return realloc(ptr, nmemb * size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (size != 0 && nmemb > (size_t)-1 / size) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    if (!enter())
+	return __libc_calloc(nmemb, size);
+    size *= nmemb;
+    if (mm_calloc != NULL && min_align <= MM_ALIGN && size != 0 &&
+	size <= heap_max) {
+	if ((p = mm_calloc(1, size)) == NULL)
+	    errno = ENOMEM;
+    }
+    else if ((p = alloc(size, min_align)) != NULL)
+	memset(p, 0, size);
+    MMPROF_MALLOC(p, size);
+    leave();
+    return p;
+}
+
+void *memalign(size_t align, size_t size)
+{
+    void *p;
+
+    if (align == 0 || (align & (align - 1)) != 0) {
+	errno = EINVAL;
+	return NULL;
+    }
+    if (!enter())
+	return __libc_memalign(align, size);
+    p = alloc(size, align);
+    MMPROF_MALLOC(p, size);
+    leave();
+    return p;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    void *p;
+
+    if (align < sizeof(void *) || (align & (align - 1)) != 0)
+	return EINVAL;
+    if ((p = memalign(align, size)) == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *valloc(size_t size)
+{
+    return memalign(mem_pagesize(), size);
+}
+
+void *pvalloc(size_t size)
+{
+    size_t pagesize = mem_pagesize();
+
+    return memalign(pagesize, (size + pagesize - 1) & ~(pagesize - 1));
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    size_t n = 0;
+
+    if (ptr == NULL || mm_usable_size == NULL)
+	return 0;
+    if (!enter())
+	return 0;
+    if (ours(ptr))
+	n = mm_usable_size(ptr);
+    leave();
+    return n;
+}
+
+/*
+ * enter - Take the lock, setting up the heap on the first call.
+ *     Returns 0 instead if this thread holds it already.
+ */
+static int enter(void)
+{
+    if (inside)
+	return 0;
+    pthread_mutex_lock(&lock);
+    inside = 1;
+    if (!ready)
+	setup();
+    return 1;
+}
+
+static void leave(void)
+{
+    inside = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+static void lock_all(void)
+{
+    enter();
+}
+
+/*
+ * setup - Create the heap. This runs on the first allocation, which
+ *     may come from the C library before any constructor has run.
+ */
+static void setup(void)
+{
+    heap_max = env_size("MMLIB_HEAP", DEFAULT_HEAP);
+    min_align = env_size("MMLIB_ALIGN", MM_ALIGN);
+    if (min_align < MM_ALIGN || (min_align & (min_align - 1)) != 0)
+	die("MMLIB_ALIGN must be a power of two, 8 or more");
+    if (min_align > MM_ALIGN && mm_memalign == NULL)
+	die("MMLIB_ALIGN above 8 needs a package with mm_memalign");
+    mem_init_max(heap_max);
+    if (mm_init() < 0)
+	die("mm_init failed");
+    if ((prof_file = getenv("MMLIB_PROF_FILE")) != NULL && *prof_file != '\0') {
+	mmprof_init(env_size("MMLIB_PROF_RATE", MMPROF_RATE));
+	atexit(prof_dump);
+    }
+    ready = 1;
+}
+
+/*
+ * prof_dump - Write the heap profile to MMLIB_PROF_FILE at exit. The
+ *     lock is held, so stdio allocates from the C library.
+ */
+static void prof_dump(void)
+{
+    static const char msg[] = "libmm: could not write the heap profile\n";
+    FILE *fp;
+    int inner = enter();
+
+    if ((fp = fopen(prof_file, "w")) == NULL ||
+	mmprof_dump(fp) < 0 || fclose(fp) != 0)
+	write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    if (inner)
+	leave();
+}
+
+/* Fork with the heap locked, so that it is consistent in the child */
+static void __attribute__((constructor)) init(void)
+{
+    pthread_atfork(lock_all, leave, leave);
+}
+
+/* env_size - The size in the environment variable name, or dflt */
+static size_t env_size(const char *name, size_t dflt)
+{
+    char *s, *end;
+    size_t n;
+
+    if ((s = getenv(name)) == NULL || *s == '\0')
+	return dflt;
+    n = strtoul(s, &end, 10);
+    switch (*end) {
+    case 'G': case 'g':
+	n <<= 10;
+	/* fall through */
+    case 'M': case 'm':
+	n <<= 10;
+	/* fall through */
+    case 'K': case 'k':
+	n <<= 10;
+	end++;
+	break;
+    }
+    if (*end != '\0' || n == 0)
+	die("bad size in the environment");
+    return n;
+}
+
+/* ours - Whether the package allocated ptr: it lies in the heap */
+static int ours(void *ptr)
+{
+    return mem_in_region(ptr, ptr) || mem_in_map(ptr, ptr);
+}
+
+/*
+ * alloc - Allocate size bytes at a multiple of align; with the lock
+ *     held. Requests of 0 bytes get a block of their own, as in glibc.
+ */
+static void *alloc(size_t size, size_t align)
+{
+    void *p;
+
+    if (size == 0)
+	size = 1;
+    if (size > heap_max)
+	p = NULL;
+    else if (align <= MM_ALIGN)
+	p = mm_malloc(size);
+    else if (mm_memalign != NULL)
+	p = mm_memalign(align, size);
+    else
+	p = NULL;
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+/* die - Give up; stdio may allocate, so write the message directly */
+static void die(const char *msg)
+{
+    write(STDERR_FILENO, "libmm: ", 7);
+    write(STDERR_FILENO, msg, strlen(msg));
+    write(STDERR_FILENO, "\n", 1);
+    abort();
+}
@@ -0,0 +1,255 @@
+/*
+ * mmprof.c - Sampling heap profiler
+ *
+ * The gaps between samples are drawn from an exponential distribution
+ * with mean rate, so every allocated byte has the same chance of being
+ * sampled however the allocations are sized (a Poisson process over
+ * the allocated bytes), and a block of s bytes is sampled with
+ * probability 1 - exp(-s/rate). pprof knows this formula and scales the
+ * sampled numbers back up using the rate in the profile header.
+ *
+ * A sampled block's call stack is looked up in a table of stacks that
+ * holds the sampled counts and bytes of each stack, and the block goes
+ * into a table of live samples so that its free can be charged to the
+ * same stack. Both tables are fixed-size arrays with open addressing,
+ * so the profiler never calls malloc; a sample that finds a table too
+ * full is dropped and counted. mmprof_filter counts the live samples
+ * per address hash, which lets MMPROF_FREE skip the live table for
+ * almost every block.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <execinfo.h>
+
+#include "mmprof.h"
+
+#define MAX_DEPTH 32    /* frames kept per stack */
+#define SKIP 1          /* frames dropped: mmprof_sample itself */
+#define STACKS 4096     /* entries in the stack table (a power of 2) */
+#define LIVE (1 << 16)  /* entries in the live table (a power of 2) */
+
+/* One call stack and the samples taken there */
+typedef struct {
+    unsigned long hash;       /* 0 if the entry is unused */
+    int depth;                /* frames in pc */
+    void *pc[MAX_DEPTH];      /* return addresses, innermost first */
+    long inuse_count;         /* sampled blocks still live */
+    long inuse_bytes;
+    long alloc_count;         /* all sampled blocks */
+    long alloc_bytes;
+} prof_stack_t;
+
+/* One live sampled block */
+typedef struct {
+    void *p;                  /* NULL if the entry is unused */
+    size_t size;
+    int stack;                /* its entry in stacks */
+} live_t;
+
+long mmprof_countdown = LONG_MAX;
+long mmprof_live;
+unsigned char mmprof_filter[MMPROF_FILTER];
+
+static long rate;                 /* mean bytes between samples, 0 if off */
+static unsigned long long rng = 88172645463325252ULL; /* xorshift state */
+static prof_stack_t stacks[STACKS];
+static int nstacks;               /* used entries in stacks */
+static live_t live[LIVE];
+static long dropped;              /* samples that found a table too full */
+
+static long next_gap(void);
+static int find_stack(void **pc, int depth);
+
+#define LIVE_HASH(p) (MMPROF_HASH(p) & (LIVE - 1))
+
+/*
+ * mmprof_init - Sample every rate bytes on average from now on, or
+ *     stop sampling if rate is 0. Forgets all samples.
+ */
+void mmprof_init(long r)
+{
+    rate = r;
+    mmprof_reset();
+}
+
+/*
+ * mmprof_reset - Forget all samples, for instance because the heap they
+ *     were taken from was thrown away.
+ */
+void mmprof_reset(void)
+{
+    memset(stacks, 0, sizeof(stacks));
+    memset(live, 0, sizeof(live));
+    memset(mmprof_filter, 0, sizeof(mmprof_filter));
+    nstacks = 0;
+    mmprof_live = 0;
+    dropped = 0;
+    mmprof_countdown = rate ? next_gap() : LONG_MAX;
+}
+
+/*
+ * next_gap - Bytes until the next sample, exponentially distributed
+ *     with mean rate.
+ */
+static long next_gap(void)
+{
+    double u;
+
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    u = ((rng >> 11) + 0.5) / 9007199254740992.0; /* uniform in (0, 1) */
+    return (long)(-log(u) * rate);
+}
+
+/*
+ * mmprof_sample - Record the block p of size bytes and the stack that
+ *     allocated it. Called by MMPROF_MALLOC when the countdown runs out.
+ */
+void mmprof_sample(void *p, size_t size)
+{
+    void *pc[MAX_DEPTH + SKIP];
+    int depth, s, i, f;
+
+    if (rate == 0) {
+	mmprof_countdown = LONG_MAX;
+	return;
+    }
+    mmprof_countdown = next_gap();
+
+    depth = backtrace(pc, MAX_DEPTH + SKIP) - SKIP;
+    if (mmprof_live >= LIVE / 2 || (s = find_stack(pc + SKIP, depth)) < 0) {
+	dropped++;
+	return;
+    }
+    stacks[s].alloc_count++;
+    stacks[s].alloc_bytes += size;
+    stacks[s].inuse_count++;
+    stacks[s].inuse_bytes += size;
+
+    for (i = LIVE_HASH(p); live[i].p != NULL; i = (i + 1) & (LIVE - 1))
+	;
+    live[i].p = p;
+    live[i].size = size;
+    live[i].stack = s;
+    mmprof_live++;
+    f = MMPROF_HASH(p);
+    if (mmprof_filter[f] < UCHAR_MAX) /* a full counter stays full */
+	mmprof_filter[f]++;
+}
+
+/*
+ * find_stack - Return the entry of the stack pc[0..depth-1], adding it
+ *     if it's new, or -1 if the table is too full to add it.
+ */
+static int find_stack(void **pc, int depth)
+{
+    unsigned long h = 14695981039346656037UL; /* FNV-1a over the frames */
+    int i;
+
+    if (depth < 0)
+	depth = 0;
+    for (i = 0; i < depth; i++)
+	h = (h ^ (unsigned long)pc[i]) * 1099511628211UL;
+    if (h == 0)
+	h = 1;
+
+    for (i = h & (STACKS - 1); stacks[i].hash != 0; i = (i + 1) & (STACKS - 1))
+	if (stacks[i].hash == h && stacks[i].depth == depth &&
+	    memcmp(stacks[i].pc, pc, depth * sizeof(void *)) == 0)
+	    return i;
+    if (nstacks >= STACKS * 3 / 4)
+	return -1;
+    nstacks++;
+    stacks[i].hash = h;
+    stacks[i].depth = depth;
+    memcpy(stacks[i].pc, pc, depth * sizeof(void *));
+    return i;
+}
+
+/*
+ * mmprof_unsample - Forget the live sample at p, if there is one.
+ *     Called by MMPROF_FREE when the filter says p might be sampled.
+ */
+void mmprof_unsample(void *p)
+{
+    int i, j, k, f;
+
+    for (i = LIVE_HASH(p); live[i].p != p; i = (i + 1) & (LIVE - 1))
+	if (live[i].p == NULL)
+	    return; /* the filter was wrong */
+
+    stacks[live[i].stack].inuse_count--;
+    stacks[live[i].stack].inuse_bytes -= live[i].size;
+    mmprof_live--;
+    f = MMPROF_HASH(p);
+    if (mmprof_filter[f] < UCHAR_MAX)
+	mmprof_filter[f]--;
+
+    /* Shift later entries of the probe run back over the hole */
+    for (j = i;;) {
+	j = (j + 1) & (LIVE - 1);
+	if (live[j].p == NULL)
+	    break;
+	k = LIVE_HASH(live[j].p);
+	if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+	    live[i] = live[j];
+	    i = j;
+	}
+    }
+    live[i].p = NULL;
+}
+
+/*
+ * mmprof_dropped - Return the number of samples dropped because a table
+ *     was too full since the last reset.
+ */
+long mmprof_dropped(void)
+{
+    return dropped;
+}
+
+/*
+ * mmprof_dump - Write the samples as a heap profile in the text format
+ *     of gperftools (heap_v2), which pprof reads: a totals line, one
+ *     line per stack with the live and the total sampled blocks and
+ *     bytes, and the memory map of the process to symbolize with.
+ */
+int mmprof_dump(FILE *fp)
+{
+    long inuse_count = 0, inuse_bytes = 0, alloc_count = 0, alloc_bytes = 0;
+    char buf[4096];
+    size_t n;
+    FILE *maps;
+    int i, d;
+
+    for (i = 0; i < STACKS; i++) {
+	inuse_count += stacks[i].inuse_count;
+	inuse_bytes += stacks[i].inuse_bytes;
+	alloc_count += stacks[i].alloc_count;
+	alloc_bytes += stacks[i].alloc_bytes;
+    }
+    fprintf(fp, "heap profile: %6ld: %8ld [%6ld: %8ld] @ heap_v2/%ld\n",
+	    inuse_count, inuse_bytes, alloc_count, alloc_bytes, rate);
+    for (i = 0; i < STACKS; i++) {
+	if (stacks[i].hash == 0)
+	    continue;
+	fprintf(fp, "%6ld: %8ld [%6ld: %8ld] @",
+		stacks[i].inuse_count, stacks[i].inuse_bytes,
+		stacks[i].alloc_count, stacks[i].alloc_bytes);
+	for (d = 0; d < stacks[i].depth; d++)
+	    fprintf(fp, " %p", stacks[i].pc[d]);
+	fprintf(fp, "\n");
+    }
+
+    fprintf(fp, "\nMAPPED_LIBRARIES:\n");
+    if ((maps = fopen("/proc/self/maps", "r")) != NULL) {
+	while ((n = fread(buf, 1, sizeof(buf), maps)) > 0)
+	    fwrite(buf, 1, n, fp);
+	fclose(maps);
+    }
+    return ferror(fp) ? -1 : 0;
+}
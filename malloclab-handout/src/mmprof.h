@@ -0,0 +1,40 @@
+/*
+ * mmprof.h - Sampling heap profiler
+ *
+ * Samples one allocation every MMPROF_RATE bytes on average and records
+ * its call stack. Call MMPROF_MALLOC after every allocation and
+ * MMPROF_FREE before every free; both are a few instructions unless the
+ * allocation is sampled or the freed block might be. mmprof_dump writes
+ * the sampled live and total allocations in the heap profile format
+ * that pprof reads (heap_v2).
+ */
+#include <stdio.h>
+
+#define MMPROF_RATE (512 * 1024) /* default mean bytes between samples */
+#define MMPROF_FILTER (1 << 16)  /* entries in the free filter */
+
+/* Fast-path state; only mmprof.c changes it */
+extern long mmprof_countdown;          /* bytes until the next sample */
+extern long mmprof_live;               /* live sampled blocks */
+extern unsigned char mmprof_filter[];  /* live samples per address hash */
+
+#define MMPROF_HASH(p) ((((unsigned long)(p) >> 3) * 2654435761u) % MMPROF_FILTER)
+
+#define MMPROF_MALLOC(p, size)                                  \
+    do {                                                        \
+	if ((mmprof_countdown -= (long)(size)) < 0 && (p) != NULL) \
+	    mmprof_sample((p), (size));                         \
+    } while (0)
+
+#define MMPROF_FREE(p)                                          \
+    do {                                                        \
+	if (mmprof_live != 0 && mmprof_filter[MMPROF_HASH(p)] != 0) \
+	    mmprof_unsample(p);                                 \
+    } while (0)
+
+void mmprof_init(long rate);  /* start sampling; rate 0 turns it off */
+void mmprof_reset(void);      /* forget all samples, e.g. after mm_init */
+void mmprof_sample(void *p, size_t size);
+void mmprof_unsample(void *p);
+int mmprof_dump(FILE *fp);    /* returns 0, or -1 on write error */
+long mmprof_dropped(void);    /* samples lost to full tables */
@@ -0,0 +1,507 @@
+/*
+ * mmtrace.c - Capture the allocations of a real program as a trace
+ *
+ * Built as libmmtrace.so and preloaded:
+ *
+ *   unix> MMTRACE_FILE=app.rep LD_PRELOAD=./libmmtrace.so app ...
+ *
+ * malloc, calloc, realloc, free, memalign, posix_memalign and
+ * aligned_alloc are wrapped; each call goes on to glibc and is recorded
+ * in a buffer of the calling thread, so that threads never wait on each
+ * other. A global counter orders the records. At exit the buffers are
+ * merged in that order, the live pointers are given trace ids, and the
+ * trace is written, with frees for the blocks still live at the end so
+ * that it is balanced.
+ *
+ * Environment:
+ *   MMTRACE_FILE    where to write the trace (default mmtrace.%p.rep;
+ *                   %p is replaced by the process id, so that forked
+ *                   children write traces of their own)
+ *   MMTRACE_BINARY  write a binary trace if set to 1
+ *
+ * Requests for 0 bytes are recorded as 1 byte. Calls made before the
+ * library is loaded, or blocks freed that were
+ * allocated some other way (valloc, say), don't appear in the trace.
+ * This uses the __libc_* entry points of glibc to reach the real
+ * allocator, which avoids looking it up with dlsym (dlsym itself
+ * allocates).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "trace.h"
+
+#define CHUNK_RECS 65536 /* records per buffer chunk */
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+extern void *__libc_memalign(size_t align, size_t size);
+
+/* One call */
+typedef struct {
+    unsigned long seq;     /* global order */
+    void *p;               /* block allocated or freed, or realloc's old block */
+    void *q;               /* realloc's new block */
+    size_t size;
+    unsigned align;
+    unsigned long link;    /* realloc: seq of its R record */
+    char type;             /* trace letter: a, c, m, r or f, or R */
+} rec_t;
+
+/* A buffer of records of one thread */
+typedef struct chunk {
+    struct chunk *next;    /* every chunk, on the list of all chunks */
+    long n;
+    rec_t rec[CHUNK_RECS];
+} chunk_t;
+
+/* Block id for a live pointer, in an open-addressing table */
+typedef struct {
+    void *p;               /* NULL if unused */
+    int id;
+} slot_t;
+
+static unsigned long seq;        /* next record's place in the order */
+static int stopped;              /* set once we write the trace */
+static unsigned long *limbo;     /* seq and id of each realloc under way */
+static long nlimbo, limbo_max;
+static chunk_t *chunks;          /* all chunks of all threads */
+static pthread_mutex_t chunks_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread chunk_t *cur;    /* this thread's current chunk */
+static __thread int busy;        /* in our own code: don't record */
+
+static slot_t *table;            /* live pointers, while writing */
+static long table_size, table_used;
+
+static unsigned long record(char type, void *p, void *q, size_t size,
+			    unsigned align, unsigned long link);
+static int cmp_rec(const void *a, const void *b);
+static int lookup(void *p);
+static void forget(void *p);
+static void remember(void *p, int id);
+static void add_op(trace_t *t, long *max, int type, int id, size_t size,
+		   unsigned align);
+static void free_stale(trace_t *t, long *max, void *p);
+static void add_limbo(unsigned long seq, int id);
+static int take_limbo(unsigned long seq);
+
+/*********************
+ * The wrapped calls
+ *********************/
+
+void *malloc(size_t size)
+{
+    void *p = __libc_malloc(size);
+
+    if (p != NULL)
+	record('a', p, NULL, size, 0, 0);
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p = __libc_calloc(nmemb, size);
+
+    if (p != NULL)
+	record('c', p, NULL, nmemb * size, 0, 0);
+    return p;
+}
+
+/*
+ * realloc - Recorded twice: R before the call, since the old block may
+ *     be handed out to another thread before realloc returns, and r
+ *     after it, with the new block
+ */
+void *realloc(void *ptr, size_t size)
+{
+    unsigned long before = ptr ? record('R', ptr, NULL, 0, 0, 0) : 0;
+    void *p = __libc_realloc(ptr, size);
+
+    record('r', ptr, p, size, 0, before);
+    return p;
+}
+
+void free(void *ptr)
+{
+    /* Before the block can be handed out again, by another thread too */
+    if (ptr != NULL)
+	record('f', ptr, NULL, 0, 0, 0);
+    __libc_free(ptr);
+}
+
+void *memalign(size_t align, size_t size)
+{
+    void *p = __libc_memalign(align, size);
+
+    if (p != NULL)
+	record('m', p, NULL, size, align, 0);
+    return p;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    return memalign(align, size);
+}
+
+int posix_memalign(void **memptr, size_t align, size_t size)
+{
+    void *p;
+
+    if (align < sizeof(void *) || (align & (align - 1)) != 0)
+	return EINVAL;
+    if ((p = memalign(align, size)) == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+static void lock_chunks(void)
+{
+    pthread_mutex_lock(&chunks_lock);
+}
+
+static void unlock_chunks(void)
+{
+    pthread_mutex_unlock(&chunks_lock);
+}
+
+/*
+ * init - Keep the chunk list unlocked in a forked child, which would
+ *     otherwise inherit the lock from a thread that doesn't exist there
+ */
+static void __attribute__((constructor)) init(void)
+{
+    pthread_atfork(lock_chunks, unlock_chunks, unlock_chunks);
+}
+
+/*
+ * record - Add a record to this thread's buffer and return its seq,
+ *     or 0 if it isn't recorded. The buffers are mmapped, since malloc
+ *     would call back in here.
+ */
+static unsigned long record(char type, void *p, void *q, size_t size,
+			    unsigned align, unsigned long link)
+{
+    rec_t *r;
+    chunk_t *c;
+
+    if (busy || stopped)
+	return 0;
+    if (cur == NULL || cur->n == CHUNK_RECS) {
+	c = mmap(NULL, sizeof(chunk_t), PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (c == MAP_FAILED)
+	    return 0;
+	c->n = 0;
+	pthread_mutex_lock(&chunks_lock);
+	c->next = chunks;
+	chunks = c;
+	pthread_mutex_unlock(&chunks_lock);
+	cur = c;
+    }
+    r = &cur->rec[cur->n];
+    r->seq = __atomic_add_fetch(&seq, 1, __ATOMIC_RELAXED);
+    r->type = type;
+    r->p = p;
+    r->q = q;
+    r->size = size;
+    r->align = align;
+    r->link = link;
+    cur->n++; /* last, in case we are writing the trace right now */
+    return r->seq;
+}
+
+/********************
+ * Writing the trace
+ ********************/
+
+/*
+ * write_trace - Merge the buffers, turn pointers into ids and write
+ *     the trace. Runs at exit.
+ */
+static void __attribute__((destructor)) write_trace(void)
+{
+    rec_t *recs, *r;
+    chunk_t *c;
+    trace_t t;
+    long n = 0, i, max = 0;
+    int id;
+    char path[PATH_MAX], *name, *s;
+    const char *binary;
+    FILE *fp;
+
+    busy = 1;
+    __atomic_store_n(&stopped, 1, __ATOMIC_SEQ_CST);
+
+    pthread_mutex_lock(&chunks_lock);
+    for (c = chunks; c != NULL; c = c->next)
+	n += c->n;
+    if ((recs = malloc((n + 1) * sizeof(rec_t))) == NULL) {
+	pthread_mutex_unlock(&chunks_lock);
+	fprintf(stderr, "mmtrace: out of memory for %ld records\n", n);
+	return;
+    }
+    for (n = 0, c = chunks; c != NULL; c = c->next) {
+	memcpy(recs + n, c->rec, c->n * sizeof(rec_t));
+	n += c->n;
+    }
+    pthread_mutex_unlock(&chunks_lock);
+    qsort(recs, n, sizeof(rec_t), cmp_rec);
+
+    /* Replay the calls with ids for pointers */
+    memset(&t, 0, sizeof(t));
+    t.weight = 1;
+    for (i = 0; i < n; i++) {
+	r = &recs[i];
+	if (r->size > INT_MAX) /* too big for the trace format */
+	    r->size = INT_MAX;
+	switch (r->type) {
+	case 'R':
+	    /* The old block is no longer ours to find by address */
+	    if ((id = lookup(r->p)) >= 0)
+		forget(r->p);
+	    add_limbo(r->seq, id);
+	    break;
+	case 'r':
+	    if (r->p != NULL && (id = take_limbo(r->link)) >= 0) {
+		if (r->q != NULL) {
+		    add_op(&t, &max, REALLOC, id, r->size, 0);
+		    free_stale(&t, &max, r->q);
+		    remember(r->q, id);
+		}
+		else if (r->size == 0) /* glibc frees on realloc(p, 0) */
+		    add_op(&t, &max, FREE, id, 0, 0);
+		else /* failed, and the old block is still there */
+		    remember(r->p, id);
+		break;
+	    }
+	    /* realloc(NULL, n), or of a block we don't know: an allocation */
+	    r->p = r->q;
+	    r->type = 'a';
+	    if (r->p == NULL)
+		break;
+	    /* fall through */
+	case 'a':
+	case 'c':
+	case 'm':
+	    free_stale(&t, &max, r->p);
+	    id = t.num_ids++;
+	    add_op(&t, &max, r->type == 'c' ? CALLOC : r->type == 'm' ? MEMALIGN :
+		   ALLOC, id, r->size, r->align);
+	    remember(r->p, id);
+	    break;
+	case 'f':
+	    if ((id = lookup(r->p)) >= 0) {
+		forget(r->p);
+		add_op(&t, &max, FREE, id, 0, 0);
+	    }
+	    break;
+	}
+    }
+    for (i = 0; i < table_size; i++)
+	if (table[i].p != NULL && table[i].p != (void *)-1)
+	    add_op(&t, &max, FREE, table[i].id, 0, 0);
+    for (i = 0; i < nlimbo; i++) /* reallocs cut short by the exit */
+	if ((id = limbo[2 * i + 1]) >= 0)
+	    add_op(&t, &max, FREE, id, 0, 0);
+
+    /* Write it */
+    if ((name = getenv("MMTRACE_FILE")) == NULL)
+	name = "mmtrace.%p.rep";
+    for (s = path; *name != '\0' && s < path + sizeof(path) - 16; name++) {
+	if (name[0] == '%' && name[1] == 'p') {
+	    s += sprintf(s, "%d", (int)getpid());
+	    name++;
+	}
+	else
+	    *s++ = *name;
+    }
+    *s = '\0';
+    binary = getenv("MMTRACE_BINARY");
+    if ((fp = fopen(path, "w")) == NULL ||
+	trace_write(fp, &t, binary != NULL && !strcmp(binary, "1")) < 0 ||
+	fclose(fp) != 0)
+	fprintf(stderr, "mmtrace: could not write %s\n", path);
+    free(recs);
+    free(t.ops);
+    free(table);
+    free(limbo);
+}
+
+/*
+ * free_stale - p is handed out again, but is still live in the table:
+ *     its free went unseen, because realloc released it in another
+ *     thread after that thread took its place in the order. Free it.
+ */
+static void free_stale(trace_t *t, long *max, void *p)
+{
+    int id;
+
+    if ((id = lookup(p)) >= 0) {
+	forget(p);
+	add_op(t, max, FREE, id, 0, 0);
+    }
+}
+
+/* add_limbo - Keep the id of a block being reallocated by the R
+   record seq (-1 if we don't know the block) */
+static void add_limbo(unsigned long seq, int id)
+{
+    if (nlimbo == limbo_max) {
+	limbo_max = limbo_max ? 2 * limbo_max : 64;
+	if ((limbo = realloc(limbo, 2 * limbo_max * sizeof(long))) == NULL) {
+	    fprintf(stderr, "mmtrace: out of memory\n");
+	    exit(1);
+	}
+    }
+    limbo[2 * nlimbo] = seq;
+    limbo[2 * nlimbo + 1] = id;
+    nlimbo++;
+}
+
+/* take_limbo - The id kept for the R record seq, or -1 */
+static int take_limbo(unsigned long seq)
+{
+    long i;
+    int id;
+
+    for (i = 0; i < nlimbo; i++) {
+	if (limbo[2 * i] == seq) {
+	    id = limbo[2 * i + 1];
+	    nlimbo--;
+	    limbo[2 * i] = limbo[2 * nlimbo];
+	    limbo[2 * i + 1] = limbo[2 * nlimbo + 1];
+	    return id;
+	}
+    }
+    return -1;
+}
+
+static int cmp_rec(const void *a, const void *b)
+{
+    unsigned long x = ((const rec_t *)a)->seq, y = ((const rec_t *)b)->seq;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * add_op - Append a request to t, growing its array as needed, and
+ *     keep the suggested heap size at the peak live payload. Requests
+ *     for 0 bytes become 1 byte: glibc returns a block for them, but a
+ *     package may return NULL, which mdriver would count as a failure.
+ */
+static void add_op(trace_t *t, long *max, int type, int id, size_t size,
+		   unsigned align)
+{
+    static double live, peak;
+    static int *sizes, nsizes;
+    traceop_t *op;
+
+    if (t->num_ops == *max) {
+	*max = *max ? 2 * *max : 4096;
+	if ((t->ops = realloc(t->ops, *max * sizeof(traceop_t))) == NULL) {
+	    fprintf(stderr, "mmtrace: out of memory\n");
+	    exit(1);
+	}
+    }
+    if (id >= nsizes) {
+	nsizes = nsizes ? 2 * nsizes : 4096;
+	if ((sizes = realloc(sizes, nsizes * sizeof(int))) == NULL) {
+	    fprintf(stderr, "mmtrace: out of memory\n");
+	    exit(1);
+	}
+    }
+    if (type != FREE && size == 0)
+	size = 1;
+    op = &t->ops[t->num_ops++];
+    op->type = type;
+    op->index = id;
+    op->size = size;
+    op->count = 0;
+    op->align = align;
+
+    live += (type == FREE ? 0 : (double)size) -
+	(type == FREE || type == REALLOC ? sizes[id] : 0);
+    sizes[id] = size;
+    if (live > peak)
+	peak = live;
+    t->sugg_heapsize = peak + 100 > INT_MAX ? INT_MAX : peak + 100;
+}
+
+/*****************************
+ * Table of the live pointers
+ *****************************/
+
+#define HASH(p) (((unsigned long)(p) >> 4) * 11400714819323198485UL)
+
+/* lookup - The id of live block p, or -1 */
+static int lookup(void *p)
+{
+    long i;
+
+    if (table_size == 0)
+	return -1;
+    for (i = HASH(p) & (table_size - 1); table[i].p != NULL;
+	 i = (i + 1) & (table_size - 1))
+	if (table[i].p == p)
+	    return table[i].id;
+    return -1;
+}
+
+/* forget - Remove p, leaving a tombstone so that probe runs stay whole */
+static void forget(void *p)
+{
+    long i;
+
+    for (i = HASH(p) & (table_size - 1); table[i].p != p;
+	 i = (i + 1) & (table_size - 1))
+	;
+    table[i].p = (void *)-1;
+}
+
+/* remember - Add p with id, rebuilding the table without its
+   tombstones, and at least four times the live pointers, when it
+   is half full */
+static void remember(void *p, int id)
+{
+    slot_t *old = table;
+    long old_size = table_size, live = 1, i, j;
+
+    if (2 * (table_used + 1) > table_size) {
+	for (j = 0; j < old_size; j++)
+	    if (old[j].p != NULL && old[j].p != (void *)-1)
+		live++;
+	for (table_size = 1 << 16; table_size < 4 * live; table_size *= 2)
+	    ;
+	if ((table = calloc(table_size, sizeof(slot_t))) == NULL) {
+	    fprintf(stderr, "mmtrace: out of memory\n");
+	    exit(1);
+	}
+	table_used = 0;
+	for (j = 0; j < old_size; j++) {
+	    if (old[j].p == NULL || old[j].p == (void *)-1)
+		continue;
+	    for (i = HASH(old[j].p) & (table_size - 1); table[i].p != NULL;
+		 i = (i + 1) & (table_size - 1))
+		;
+	    table[i] = old[j];
+	    table_used++;
+	}
+	free(old);
+    }
+    for (i = HASH(p) & (table_size - 1); table[i].p != NULL &&
+	     table[i].p != (void *)-1; i = (i + 1) & (table_size - 1))
+	;
+    if (table[i].p == NULL)
+	table_used++;
+    table[i].p = p;
+    table[i].id = id;
+}
@@ -0,0 +1,310 @@
+/*
+ * trace.c - Reading and writing trace files
+ *
+ * Shared by mdriver and the trace tools, so that they all agree on the
+ * formats. The binary fields are put together byte by byte, which keeps
+ * binary traces portable between hosts of either byte order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define HDR_BYTES 24 /* magic, version and the four header fields */
+#define OP_BYTES 16  /* type, index, size, aux */
+
+static const char op_letters[] = {
+    [ALLOC] = 'a', [FREE] = 'f', [REALLOC] = 'r', [ALLOC_BATCH] = 'A',
+    [FREE_BATCH] = 'F', [MEMALIGN] = 'm', [CALLOC] = 'c'
+};
+
+static int read_text(FILE *fp, trace_t *t, const char *path);
+static int read_binary(FILE *fp, trace_t *t, const char *path);
+static int check_ids(trace_t *t, const char *path);
+static int op_type(int letter);
+static unsigned get32(const unsigned char *p);
+static void put32(unsigned char *p, unsigned v);
+
+/*
+ * trace_read - Read the trace in path, in either format
+ */
+trace_t *trace_read(const char *path)
+{
+    FILE *fp;
+    trace_t *t;
+    char magic[4];
+    int ok;
+
+    if ((fp = fopen(path, "r")) == NULL) {
+	fprintf(stderr, "Could not open %s\n", path);
+	return NULL;
+    }
+    if ((t = calloc(1, sizeof(trace_t))) == NULL) {
+	fprintf(stderr, "Out of memory for %s\n", path);
+	fclose(fp);
+	return NULL;
+    }
+    if (fread(magic, 1, 4, fp) == 4 && memcmp(magic, TRACE_MAGIC, 4) == 0)
+	ok = read_binary(fp, t, path);
+    else {
+	rewind(fp);
+	ok = read_text(fp, t, path);
+    }
+    fclose(fp);
+    if (ok < 0 || check_ids(t, path) < 0) {
+	trace_free(t);
+	return NULL;
+    }
+    return t;
+}
+
+/*
+ * trace_write - Write t to fp in the text format, or in the binary
+ *     one if binary is set
+ */
+int trace_write(FILE *fp, const trace_t *t, int binary)
+{
+    unsigned char buf[HDR_BYTES];
+    const traceop_t *op;
+    int i;
+
+    if (!binary) {
+	fprintf(fp, "%d\n%d\n%d\n%d\n",
+		t->sugg_heapsize, t->num_ids, t->num_ops, t->weight);
+	for (i = 0; i < t->num_ops; i++) {
+	    op = &t->ops[i];
+	    switch (op->type) {
+	    case FREE:
+		fprintf(fp, "f %d\n", op->index);
+		break;
+	    case FREE_BATCH:
+		fprintf(fp, "F %d %d\n", op->index, op->count);
+		break;
+	    case ALLOC_BATCH:
+		fprintf(fp, "A %d %d %d\n", op->index, op->count, op->size);
+		break;
+	    case MEMALIGN:
+		fprintf(fp, "m %d %d %d\n", op->index, op->align, op->size);
+		break;
+	    default:
+		fprintf(fp, "%c %d %d\n", op_letters[op->type],
+			op->index, op->size);
+		break;
+	    }
+	}
+	return ferror(fp) ? -1 : 0;
+    }
+
+    memcpy(buf, TRACE_MAGIC, 4);
+    put32(buf + 4, TRACE_VERSION);
+    put32(buf + 8, t->sugg_heapsize);
+    put32(buf + 12, t->num_ids);
+    put32(buf + 16, t->num_ops);
+    put32(buf + 20, t->weight);
+    fwrite(buf, 1, HDR_BYTES, fp);
+    for (i = 0; i < t->num_ops; i++) {
+	op = &t->ops[i];
+	put32(buf, op_letters[op->type]);
+	put32(buf + 4, op->index);
+	put32(buf + 8, op->size);
+	put32(buf + 12, op->type == MEMALIGN ? op->align : op->count);
+	fwrite(buf, 1, OP_BYTES, fp);
+    }
+    return ferror(fp) ? -1 : 0;
+}
+
+/*
+ * trace_free - Free the trace record and the arrays it points to
+ */
+void trace_free(trace_t *t)
+{
+    free(t->ops);
+    free(t->blocks);
+    free(t->block_sizes);
+    free(t);
+}
+
+/*
+ * read_text - Read the header and requests of a text trace
+ */
+static int read_text(FILE *fp, trace_t *t, const char *path)
+{
+    char type[16];
+    unsigned index, size, count, align;
+    traceop_t *op;
+    int n, ok;
+
+    if (fscanf(fp, "%d %d %d %d", &t->sugg_heapsize, &t->num_ids,
+	       &t->num_ops, &t->weight) != 4 || t->num_ops < 0) {
+	fprintf(stderr, "Bad header in %s\n", path);
+	return -1;
+    }
+    if ((t->ops = malloc((t->num_ops + 1) * sizeof(traceop_t))) == NULL) {
+	fprintf(stderr, "Out of memory for the %d requests in %s\n",
+		t->num_ops, path);
+	return -1;
+    }
+
+    for (n = 0; fscanf(fp, "%15s", type) == 1; n++) {
+	if (n == t->num_ops) {
+	    fprintf(stderr, "More than the %d requests of its header in %s\n",
+		    t->num_ops, path);
+	    return -1;
+	}
+	op = &t->ops[n];
+	op->count = op->align = op->size = 0;
+	switch (op->type = op_type(type[0])) {
+	case ALLOC:
+	case REALLOC:
+	case CALLOC:
+	    ok = fscanf(fp, "%u %u", &index, &size) == 2;
+	    op->size = size;
+	    break;
+	case FREE:
+	    ok = fscanf(fp, "%u", &index) == 1;
+	    break;
+	case MEMALIGN:
+	    ok = fscanf(fp, "%u %u %u", &index, &align, &size) == 3;
+	    op->align = align;
+	    op->size = size;
+	    break;
+	case ALLOC_BATCH:
+	    ok = fscanf(fp, "%u %u %u", &index, &count, &size) == 3;
+	    op->count = count;
+	    op->size = size;
+	    break;
+	case FREE_BATCH:
+	    ok = fscanf(fp, "%u %u", &index, &count) == 2;
+	    op->count = count;
+	    break;
+	default:
+	    fprintf(stderr, "Bogus type character (%c) in tracefile %s\n",
+		    type[0], path);
+	    return -1;
+	}
+	if (!ok) {
+	    fprintf(stderr, "Missing fields in request %d (%s) of %s\n",
+		    n, type, path);
+	    return -1;
+	}
+	op->index = index;
+    }
+    if (n != t->num_ops) {
+	fprintf(stderr, "%d requests instead of the %d of its header in %s\n",
+		n, t->num_ops, path);
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * read_binary - Read a binary trace, the magic number already read
+ */
+static int read_binary(FILE *fp, trace_t *t, const char *path)
+{
+    unsigned char hdr[HDR_BYTES], *buf, *p;
+    traceop_t *op;
+    int i, type;
+
+    if (fread(hdr + 4, 1, HDR_BYTES - 4, fp) != HDR_BYTES - 4 ||
+	get32(hdr + 4) != TRACE_VERSION) {
+	fprintf(stderr, "Bad header in %s\n", path);
+	return -1;
+    }
+    t->sugg_heapsize = get32(hdr + 8);
+    t->num_ids = get32(hdr + 12);
+    t->num_ops = get32(hdr + 16);
+    t->weight = get32(hdr + 20);
+    if (t->num_ops < 0 ||
+	(t->ops = malloc((t->num_ops + 1) * sizeof(traceop_t))) == NULL ||
+	(buf = malloc((size_t)t->num_ops * OP_BYTES + 1)) == NULL) {
+	fprintf(stderr, "Out of memory for the %d requests in %s\n",
+		t->num_ops, path);
+	return -1;
+    }
+    if (fread(buf, OP_BYTES, t->num_ops, fp) != (size_t)t->num_ops) {
+	fprintf(stderr, "Fewer than the %d requests of its header in %s\n",
+		t->num_ops, path);
+	free(buf);
+	return -1;
+    }
+
+    for (i = 0, p = buf; i < t->num_ops; i++, p += OP_BYTES) {
+	op = &t->ops[i];
+	if ((type = op_type(get32(p))) < 0) {
+	    fprintf(stderr, "Bogus request type %u in tracefile %s\n",
+		    get32(p), path);
+	    free(buf);
+	    return -1;
+	}
+	op->type = type;
+	op->index = get32(p + 4);
+	op->size = get32(p + 8);
+	op->count = op->type == MEMALIGN ? 0 : get32(p + 12);
+	op->align = op->type == MEMALIGN ? get32(p + 12) : 0;
+    }
+    free(buf);
+    return 0;
+}
+
+/*
+ * check_ids - Check that every request names ids in 0..num_ids - 1, so
+ *     that readers can index arrays of num_ids entries with them, and
+ *     that the ids allocated are all of those
+ */
+static int check_ids(trace_t *t, const char *path)
+{
+    int i, count, last, max_index = -1;
+    traceop_t *op;
+
+    for (i = 0; i < t->num_ops; i++) {
+	op = &t->ops[i];
+	count = op->type == ALLOC_BATCH || op->type == FREE_BATCH ? op->count : 1;
+	if (op->index < 0 || op->index >= t->num_ids ||
+	    count < 0 || count > t->num_ids - op->index) {
+	    fprintf(stderr, "Request %d names ids outside 0..%d in %s\n",
+		    i, t->num_ids - 1, path);
+	    return -1;
+	}
+	if (op->size < 0 || op->align < 0) {
+	    fprintf(stderr, "Negative size in request %d of %s\n", i, path);
+	    return -1;
+	}
+	if (op->type == FREE || op->type == FREE_BATCH)
+	    continue;
+	last = op->index + count - 1;
+	if (last > max_index)
+	    max_index = last;
+    }
+    if (max_index != t->num_ids - 1) {
+	fprintf(stderr, "Ids up to %d instead of the %d of its header in %s\n",
+		max_index, t->num_ids, path);
+	return -1;
+    }
+    return 0;
+}
+
+/* op_type - The request type for a type letter, or -1 */
+static int op_type(int letter)
+{
+    int i;
+
+    for (i = 0; i < (int)sizeof(op_letters); i++)
+	if (op_letters[i] == letter)
+	    return i;
+    return -1;
+}
+
+static unsigned get32(const unsigned char *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (unsigned)p[3] << 24;
+}
+
+static void put32(unsigned char *p, unsigned v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
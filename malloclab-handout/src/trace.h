@@ -0,0 +1,51 @@
+/*
+ * trace.h - Reading and writing trace files
+ *
+ * A trace is either the text format described in traces/README or the
+ * equivalent binary format, which loads much faster for traces of
+ * millions of requests. trace_read tells them apart by the magic
+ * number at the start of a binary trace: its header is
+ *
+ *     "MMTB" version sugg_heapsize num_ids num_ops weight
+ *
+ * followed by num_ops requests of type index size aux, where aux is the
+ * count of a batch request or the alignment of a memalign request. The
+ * version and the fields are 32-bit little-endian integers, except for
+ * type, which is a letter (a, r, f, ...) padded to 32 bits.
+ */
+#include <stdio.h>
+#include <stddef.h>
+
+#define TRACE_MAGIC "MMTB"
+#define TRACE_VERSION 1
+
+/* One request of a trace */
+typedef struct {
+    enum {ALLOC, FREE, REALLOC,
+	  ALLOC_BATCH, FREE_BATCH, MEMALIGN, CALLOC} type; /* type of request */
+    int index;                        /* index for free() to use later */
+    int size;                         /* byte size of alloc/realloc request */
+    int count;                        /* ids index..index+count-1 in a batch */
+    int align;                        /* alignment of a memalign request */
+} traceop_t;
+
+/* Holds the information for one trace file*/
+typedef struct {
+    int sugg_heapsize;   /* suggested heap size (unused) */
+    int num_ids;         /* number of alloc/realloc ids */
+    int num_ops;         /* number of distinct requests */
+    int weight;          /* weight for this trace (unused) */
+    traceop_t *ops;      /* array of requests */
+    char **blocks;       /* array of ptrs returned by malloc/realloc... */
+    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+} trace_t;
+
+/* Read a text or binary trace; prints why and returns NULL on error.
+   The ids of every request are checked to lie in 0..num_ids-1, and
+   sizes to be non-negative. blocks and block_sizes are left NULL for
+   the caller to allocate. */
+trace_t *trace_read(const char *path);
+/* Write t as text, or binary if binary is set; returns 0 or -1 */
+int trace_write(FILE *fp, const trace_t *t, int binary);
+/* Free t, its ops and its blocks and block_sizes if it has them */
+void trace_free(trace_t *t);
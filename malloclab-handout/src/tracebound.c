@@ -0,0 +1,452 @@
+/*
+ * tracebound.c - How small can the heap for a trace be?
+ *
+ * Usage: tracebound [-h] [-a <align>] [-o <overhead>] [-m <min>]
+ *                   [-l <blocks>] <trace> ...
+ *
+ * mdriver scores utilization against the peak live payload, a heap no
+ * allocator can reach: every block takes up at least its payload plus
+ * any header, rounded up to the alignment, and blocks that are live at
+ * different times can't always share space. tracebound computes, for
+ * each trace:
+ *
+ *   payload    the peak live payload, the ideal of mdriver
+ *   bound      the peak of the live block sizes, where a block of p
+ *              bytes takes max(<min>, align(p + <overhead>)). No
+ *              allocator with that block layout does better.
+ *   first-fit  the heap of an address-ordered first fit that knows
+ *              nothing of the future, with the same block sizes
+ *   by-size    the heap of offline placement with the whole trace
+ *   by-life    known: blocks are placed at the lowest offset free for
+ *              their whole lifetime, largest first or longest-lived
+ *              first, as in dynamic storage allocation heuristics
+ *
+ * The optimum lies between bound and the best of the heuristics. The
+ * util column is payload / bound, the most utilization an allocator
+ * can get on the trace; best is payload over the smallest heap that
+ * one of the heuristics reached. By default blocks are 8-byte aligned with no
+ * overhead; -o 8 -m 16 models the boundary tags of mm.c.
+ *
+ * Time runs in requests. A realloc ends the old block and starts the
+ * new one at the same request, as if the copy were free, and blocks
+ * never freed live to the end. The offline heuristics take quadratic
+ * time, so they are skipped on traces of more than <blocks> blocks
+ * (default 100000).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define ALIGN_TO(x, a) (((x) + (a) - 1) / (a) * (a))
+
+/* One block, from the request that allocates it to the one that frees it */
+typedef struct {
+    long start, end;      /* live during requests start..end-1 */
+    long payload;         /* bytes requested */
+    long size;            /* block size */
+    long align;           /* alignment of its offset */
+    long offset;          /* where a heuristic put it */
+} block_t;
+
+/* A free range of the first-fit heap */
+typedef struct {
+    long lo, hi;
+} range_t;
+
+/* What the block size of a payload is; set from the options */
+static long align = 8, overhead = 0, min_block = 8;
+
+static block_t *blocks;   /* of the trace at hand, for the comparisons */
+
+static long collect(const trace_t *t, long *payloadp);
+static long block_size(long payload);
+static long *sorted(long n, int (*cmp)(const void *, const void *));
+static long peak_load(long n);
+static long first_fit(long n);
+static long ff_take(long size, long al);
+static void ff_give(long lo, long hi);
+static long greedy(long n, int (*cmp)(const void *, const void *));
+static int by_start(const void *a, const void *b);
+static int by_end(const void *a, const void *b);
+static int by_size(const void *a, const void *b);
+static int by_life(const void *a, const void *b);
+static void *xmalloc(size_t size);
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    long limit = 100000, n, payload, bound, ff, bs, bl, best;
+    trace_t *t;
+    char *name;
+    int errors = 0;
+    char c;
+
+    while ((c = getopt(argc, argv, "a:o:m:l:h")) != EOF) {
+	switch (c) {
+	case 'a': /* Alignment of every block */
+	    align = atol(optarg);
+	    break;
+	case 'o': /* Bytes added to every payload */
+	    overhead = atol(optarg);
+	    break;
+	case 'm': /* Minimum block size */
+	    min_block = atol(optarg);
+	    break;
+	case 'l': /* Largest trace for the offline heuristics */
+	    limit = atol(optarg);
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind == argc || align <= 0 || (align & (align - 1)) != 0 ||
+	overhead < 0 || min_block < 0) {
+	usage();
+	exit(1);
+    }
+
+    printf("Blocks of max(%ld, align(payload + %ld, %ld)) bytes\n",
+	   min_block, overhead, align);
+    printf("%-24s%10s%10s%10s%10s%10s%7s%7s\n", "trace", "payload", "bound",
+	   "first-fit", "by-size", "by-life", "util", "best");
+    for (; optind < argc; optind++) {
+	if ((t = trace_read(argv[optind])) == NULL) {
+	    errors++;
+	    continue;
+	}
+	n = collect(t, &payload);
+	bound = peak_load(n);
+	best = ff = first_fit(n);
+	bs = bl = -1;
+	if (n <= limit) {
+	    bs = greedy(n, by_size);
+	    bl = greedy(n, by_life);
+	    best = bs < best ? bs : best;
+	    best = bl < best ? bl : best;
+	}
+
+	name = strrchr(argv[optind], '/') ? strrchr(argv[optind], '/') + 1 : argv[optind];
+	printf("%-24s%10ld%10ld%10ld", name, payload, bound, ff);
+	if (bs < 0)
+	    printf("%10s%10s", "-", "-");
+	else
+	    printf("%10ld%10ld", bs, bl);
+	printf("%6.1f%%%6.1f%%\n", bound ? 100.0 * payload / bound : 0.0,
+	       best ? 100.0 * payload / best : 0.0);
+	free(blocks);
+	trace_free(t);
+    }
+    exit(errors != 0);
+}
+
+/*
+ * collect - Turn the requests of t into blocks with lifetimes. Returns
+ *     the number of blocks, and the peak live payload in *payloadp,
+ *     counted as mdriver does.
+ */
+static long collect(const trace_t *t, long *payloadp)
+{
+    const traceop_t *op;
+    long *live, i, n = 0, max = 0, payload = 0, peak = 0;
+    int j, id, count;
+    block_t *b;
+
+    for (i = 0; i < t->num_ops; i++) {
+	op = &t->ops[i];
+	if (op->type == ALLOC_BATCH)
+	    max += op->count;
+	else if (op->type != FREE && op->type != FREE_BATCH)
+	    max++;
+    }
+    blocks = xmalloc(max * sizeof(block_t) + 1);
+    live = xmalloc(t->num_ids * sizeof(long) + 1);  /* block of an id, or -1 */
+    for (i = 0; i < t->num_ids; i++)
+	live[i] = -1;
+
+    for (i = 0; i < t->num_ops; i++) {
+	op = &t->ops[i];
+	count = op->type == ALLOC_BATCH || op->type == FREE_BATCH ? op->count : 1;
+	for (j = 0; j < count; j++) {
+	    id = op->index + j;
+	    if (live[id] >= 0) {
+		/* a free, a realloc or an id allocated twice ends the block */
+		blocks[live[id]].end = i;
+		payload -= blocks[live[id]].payload;
+		live[id] = -1;
+	    }
+	    if (op->type == FREE || op->type == FREE_BATCH)
+		continue;
+	    b = &blocks[n];
+	    b->start = i;
+	    b->end = t->num_ops;
+	    b->payload = op->size;
+	    b->size = block_size(op->size);
+	    b->align = op->type == MEMALIGN && op->align > align ? op->align : align;
+	    payload += op->size;
+	    if (payload > peak)
+		peak = payload;
+	    live[id] = n++;
+	}
+    }
+    free(live);
+    *payloadp = peak;
+    return n;
+}
+
+static long block_size(long payload)
+{
+    long size = ALIGN_TO(payload + overhead, align);
+
+    return size < min_block ? min_block : size;
+}
+
+/* sorted - The indices of the n blocks, in the order of cmp */
+static long *sorted(long n, int (*cmp)(const void *, const void *))
+{
+    long *order = xmalloc(n * sizeof(long) + 1);
+    long i;
+
+    for (i = 0; i < n; i++)
+	order[i] = i;
+    qsort(order, n, sizeof(long), cmp);
+    return order;
+}
+
+/*
+ * peak_load - The largest total size of the blocks live at once. The
+ *     blocks a request frees are gone before the ones it allocates.
+ */
+static long peak_load(long n)
+{
+    long *starts = sorted(n, by_start), *ends = sorted(n, by_end);
+    long i, j, load = 0, peak = 0;
+
+    for (i = j = 0; i < n; i++) {
+	while (blocks[ends[j]].end <= blocks[starts[i]].start)
+	    load -= blocks[ends[j++]].size;
+	load += blocks[starts[i]].size;
+	if (load > peak)
+	    peak = load;
+    }
+    free(starts);
+    free(ends);
+    return peak;
+}
+
+/* The free ranges of the first-fit heap, by address, and its top */
+static range_t *ranges;
+static long nranges, max_ranges, top;
+
+/*
+ * first_fit - Replay the blocks on an address-ordered first fit with
+ *     immediate coalescing and return the size of its heap
+ */
+static long first_fit(long n)
+{
+    long *starts = sorted(n, by_start), *ends = sorted(n, by_end);
+    long i, j;
+    block_t *b;
+
+    nranges = top = 0;
+    for (i = j = 0; i < n; i++) {
+	while (blocks[ends[j]].end <= blocks[starts[i]].start) {
+	    b = &blocks[ends[j++]];
+	    ff_give(b->offset, b->offset + b->size);
+	}
+	b = &blocks[starts[i]];
+	b->offset = ff_take(b->size, b->align);
+    }
+    free(starts);
+    free(ends);
+    free(ranges);
+    ranges = NULL;
+    max_ranges = 0;
+    return top;
+}
+
+/* ff_take - Allocate size bytes at a multiple of al; returns the offset */
+static long ff_take(long size, long al)
+{
+    long i, lo, hi;
+
+    for (i = 0; i < nranges; i++) {
+	lo = ALIGN_TO(ranges[i].lo, al);
+	if (lo + size > ranges[i].hi)
+	    continue;
+	hi = ranges[i].hi;
+	if (lo + size == hi) {  /* take the end of the range */
+	    ranges[i].hi = lo;
+	    if (lo == ranges[i].lo) {
+		memmove(&ranges[i], &ranges[i + 1],
+			(nranges - i - 1) * sizeof(range_t));
+		nranges--;
+	    }
+	}
+	else if (lo == ranges[i].lo)  /* take the start */
+	    ranges[i].lo = lo + size;
+	else {  /* alignment leaves a range in front */
+	    ranges[i].hi = lo;
+	    ff_give(lo + size, hi);
+	}
+	return lo;
+    }
+
+    /* Nothing fits: grow the heap, using a free range at the top */
+    if (nranges > 0 && ranges[nranges - 1].hi == top) {
+	top = ranges[nranges - 1].lo;
+	nranges--;
+    }
+    lo = ALIGN_TO(top, al);
+    if (lo > top)
+	ff_give(top, lo);
+    top = lo + size;
+    return lo;
+}
+
+/* ff_give - Free the range lo..hi-1, coalescing it with its neighbours */
+static void ff_give(long lo, long hi)
+{
+    long a = 0, b = nranges, m;
+
+    while (a < b) {  /* the first range above lo */
+	m = (a + b) / 2;
+	if (ranges[m].lo < lo)
+	    a = m + 1;
+	else
+	    b = m;
+    }
+    if (a > 0 && ranges[a - 1].hi == lo) {
+	ranges[a - 1].hi = hi;
+	if (a < nranges && ranges[a].lo == hi) {
+	    ranges[a - 1].hi = ranges[a].hi;
+	    memmove(&ranges[a], &ranges[a + 1], (nranges - a - 1) * sizeof(range_t));
+	    nranges--;
+	}
+	return;
+    }
+    if (a < nranges && ranges[a].lo == hi) {
+	ranges[a].lo = lo;
+	return;
+    }
+    if (nranges == max_ranges) {
+	max_ranges = max_ranges ? 2 * max_ranges : 1024;
+	if ((ranges = realloc(ranges, max_ranges * sizeof(range_t))) == NULL) {
+	    fprintf(stderr, "Out of memory\n");
+	    exit(1);
+	}
+    }
+    memmove(&ranges[a + 1], &ranges[a], (nranges - a) * sizeof(range_t));
+    ranges[a].lo = lo;
+    ranges[a].hi = hi;
+    nranges++;
+}
+
+/*
+ * greedy - Place the blocks in the order of cmp, each at the lowest
+ *     offset that is free during its whole lifetime, and return the
+ *     size of the heap. The blocks placed so far are kept by offset,
+ *     so the search is a single pass that stops at the first gap.
+ */
+static long greedy(long n, int (*cmp)(const void *, const void *))
+{
+    long *order = sorted(n, cmp), *placed = xmalloc(n * sizeof(long) + 1);
+    long i, k, a, b, m, at, heap = 0;
+    block_t *x, *p;
+
+    for (i = 0; i < n; i++) {
+	x = &blocks[order[i]];
+	at = 0;
+	for (k = 0; k < i; k++) {
+	    p = &blocks[placed[k]];
+	    if (p->offset >= at + x->size)
+		break;
+	    if (p->start < x->end && x->start < p->end &&
+		p->offset + p->size > at)
+		at = ALIGN_TO(p->offset + p->size, x->align);
+	}
+	x->offset = at;
+	if (at + x->size > heap)
+	    heap = at + x->size;
+
+	for (a = 0, b = i; a < b; ) {  /* keep placed sorted by offset */
+	    m = (a + b) / 2;
+	    if (blocks[placed[m]].offset <= at)
+		a = m + 1;
+	    else
+		b = m;
+	}
+	memmove(&placed[a + 1], &placed[a], (i - a) * sizeof(long));
+	placed[a] = order[i];
+    }
+    free(order);
+    free(placed);
+    return heap;
+}
+
+#define BLOCK(p) (&blocks[*(const long *)(p)])
+#define CMP(x, y) (((x) > (y)) - ((x) < (y)))
+
+static int by_start(const void *a, const void *b)
+{
+    return CMP(BLOCK(a)->start, BLOCK(b)->start);
+}
+
+static int by_end(const void *a, const void *b)
+{
+    return CMP(BLOCK(a)->end, BLOCK(b)->end);
+}
+
+/* by_size - Largest first, then longest-lived, then oldest */
+static int by_size(const void *a, const void *b)
+{
+    const block_t *x = BLOCK(a), *y = BLOCK(b);
+
+    if (x->size != y->size)
+	return CMP(y->size, x->size);
+    if (x->end - x->start != y->end - y->start)
+	return CMP(y->end - y->start, x->end - x->start);
+    return CMP(x->start, y->start);
+}
+
+/* by_life - Longest-lived first, then largest, then oldest */
+static int by_life(const void *a, const void *b)
+{
+    const block_t *x = BLOCK(a), *y = BLOCK(b);
+
+    if (x->end - x->start != y->end - y->start)
+	return CMP(y->end - y->start, x->end - x->start);
+    if (x->size != y->size)
+	return CMP(y->size, x->size);
+    return CMP(x->start, y->start);
+}
+
+static void *xmalloc(size_t size)
+{
+    void *p;
+
+    if ((p = malloc(size)) == NULL) {
+	fprintf(stderr, "Out of memory\n");
+	exit(1);
+    }
+    return p;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracebound [-h] [-a <align>] [-o <overhead>] [-m <min>]\n"
+	    "                  [-l <blocks>] <trace> ...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-a <align>     Align blocks to <align> bytes (default 8).\n");
+    fprintf(stderr, "\t-h             Print this message.\n");
+    fprintf(stderr, "\t-l <blocks>    Skip the offline heuristics on traces of more\n"
+	    "\t               blocks (default 100000).\n");
+    fprintf(stderr, "\t-m <min>       Make blocks at least <min> bytes (default 8).\n");
+    fprintf(stderr, "\t-o <overhead>  Add <overhead> bytes to every payload (default 0).\n");
+}
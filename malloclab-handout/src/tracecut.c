@@ -0,0 +1,483 @@
+/*
+ * tracecut.c - Cut a long trace down to a short one with the same mix
+ *
+ * Usage: tracecut [-bh] [-w <from>:<to>] [-s <fraction>] [-S <seed>]
+ *                 [-t <tolerance>] [-o <file>] <trace>
+ *
+ * -w keeps the requests from <from> up to, but not including, <to>.
+ * Either end is a request number or a percentage of the trace (40%),
+ * and may be left out. The blocks live when the window opens are
+ * allocated first, in the order they were allocated and with the size
+ * they have then, so that the window starts on the heap it had in the
+ * full trace; the blocks still live when it closes are freed at the
+ * end, so that the result is balanced (what checktrace.pl does for
+ * text traces).
+ *
+ * -s keeps the blocks of a random <fraction> of the ids, and all the
+ * requests on them. Block ids are numbered again from 0, batches whose
+ * blocks are no longer consecutive become single requests, and the
+ * suggested heap size is the new peak live payload plus 100.
+ *
+ * A sample only has the mix of the trace on average, so it is checked:
+ * the median, 90th percentile and mean of the request sizes, and the
+ * median and 90th percentile of the lifetimes (in requests of the
+ * input) must all be within <tolerance> (default 0.05) of those of the
+ * whole window. If they aren't, the next seeds are tried, up to
+ * MAX_TRIES, and the closest sample is kept. The comparison is printed
+ * on stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <math.h>
+
+#include "trace.h"
+
+#define MAX_TRIES 20  /* seeds tried for a sample within the tolerance */
+#define NSTATS 5      /* statistics in a summary_t */
+
+/* The mix of a cut, compared between the sample and the whole window */
+typedef struct {
+    double v[NSTATS];  /* size p50, p90 and mean, lifetime p50 and p90 */
+} summary_t;
+
+static const char *const stat_names[NSTATS] = {
+    "size p50", "size p90", "size mean", "life p50", "life p90"};
+
+static const trace_t *in;  /* the input trace */
+static long from, to;      /* the window */
+
+/* Per-id state of the input while cutting */
+static int *new_id;        /* id in the output, or -1 if not live there */
+static int *cur_size;      /* current size of a live block */
+static long *born;         /* request that allocated it */
+static char *alloc_type;   /* ... and its type (ALLOC, CALLOC, MEMALIGN) */
+static int *alloc_align;   /* ... and alignment */
+
+static trace_t *cut(double frac, unsigned long long seed, summary_t *sum);
+static int kept(int id, double frac, unsigned long long seed);
+static void emit(trace_t *t, int *max, int type, int index, int size,
+		 int count, int align);
+static void note_alloc(trace_t *t, int id, int size, long req);
+static void note_free(int id, long req);
+static long parse_end(const char *s, long dflt);
+static double distance(const summary_t *a, const summary_t *b);
+static double quantile(long *v, long n, double q);
+static int cmp_long(const void *a, const void *b);
+static int cmp_born(const void *a, const void *b);
+static void *xmalloc(size_t size);
+static void usage(void);
+
+/* Samples of the sizes and lifetimes of the cut being made */
+static long *sizes, *lives;
+static long nsizes, nlives, max_samples;
+static long live_bytes, peak_bytes;
+
+int main(int argc, char **argv)
+{
+    char *outfile = NULL, *window = NULL, *colon;
+    double frac = 1, tol = 0.05, d, best_d = HUGE_VAL;
+    unsigned long long seed = 1, best_seed = 1;
+    int binary = 0, i, try;
+    summary_t ref, sum, best_sum;
+    trace_t *t, *best = NULL;
+    FILE *fp = stdout;
+    char c;
+
+    while ((c = getopt(argc, argv, "bw:s:S:t:o:h")) != EOF) {
+	switch (c) {
+	case 'b': /* Write a binary trace */
+	    binary = 1;
+	    break;
+	case 'w': /* Window of requests */
+	    window = optarg;
+	    break;
+	case 's': /* Fraction of the ids to keep */
+	    frac = atof(optarg);
+	    break;
+	case 'S': /* Seed of the sample */
+	    seed = strtoull(optarg, NULL, 0);
+	    break;
+	case 't': /* Tolerance of the sample */
+	    tol = atof(optarg);
+	    break;
+	case 'o': /* Output file */
+	    outfile = optarg;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind != argc - 1 || frac <= 0 || frac > 1) {
+	usage();
+	exit(1);
+    }
+    if ((in = trace_read(argv[optind])) == NULL)
+	exit(1);
+
+    from = 0;
+    to = in->num_ops;
+    if (window != NULL) {
+	if ((colon = strchr(window, ':')) == NULL) {
+	    usage();
+	    exit(1);
+	}
+	*colon = '\0';
+	from = parse_end(window, 0);
+	to = parse_end(colon + 1, in->num_ops);
+	if (from < 0 || to > in->num_ops || from > to) {
+	    fprintf(stderr, "Bad window %s:%s for %d requests\n", window,
+		    colon + 1, in->num_ops);
+	    exit(1);
+	}
+    }
+
+    new_id = xmalloc(in->num_ids * sizeof(int) + 1);
+    cur_size = xmalloc(in->num_ids * sizeof(int) + 1);
+    born = xmalloc(in->num_ids * sizeof(long) + 1);
+    alloc_type = xmalloc(in->num_ids + 1);
+    alloc_align = xmalloc(in->num_ids * sizeof(int) + 1);
+    max_samples = in->num_ids;  /* the blocks live when the window opens */
+    for (i = 0; i < in->num_ops; i++)
+	max_samples += in->ops[i].type == ALLOC_BATCH ||
+	    in->ops[i].type == FREE_BATCH ? in->ops[i].count : 1;
+
+    /* The whole window is the reference; sample until close to it */
+    t = cut(1, seed, &ref);
+    if (frac == 1)
+	best = t;
+    else {
+	trace_free(t);
+	for (try = 0; try < MAX_TRIES && best_d > tol; try++) {
+	    t = cut(frac, seed + try, &sum);
+	    if ((d = distance(&ref, &sum)) < best_d) {
+		if (best != NULL)
+		    trace_free(best);
+		best = t;
+		best_d = d;
+		best_seed = seed + try;
+		best_sum = sum;
+	    }
+	    else
+		trace_free(t);
+	}
+    }
+
+    fprintf(stderr, "Requests %ld to %ld, %g of the ids", from, to, frac);
+    if (frac < 1)
+	fprintf(stderr, " (seed %llu)", best_seed);
+    fprintf(stderr, ": %d requests, %d ids\n", best->num_ops, best->num_ids);
+    if (frac < 1) {
+	for (i = 0; i < NSTATS; i++)
+	    fprintf(stderr, "  %-10s %12.1f %12.1f\n", stat_names[i],
+		    ref.v[i], best_sum.v[i]);
+	fprintf(stderr, "  %s: largest difference %.1f%%\n",
+		best_d <= tol ? "Within the tolerance" : "WARNING: Off the tolerance",
+		100 * best_d);
+    }
+
+    if (outfile != NULL && (fp = fopen(outfile, "w")) == NULL) {
+	fprintf(stderr, "Could not open %s\n", outfile);
+	exit(1);
+    }
+    if (trace_write(fp, best, binary) < 0) {
+	fprintf(stderr, "Error writing the trace\n");
+	exit(1);
+    }
+    if (fp != stdout)
+	fclose(fp);
+    exit(0);
+}
+
+/*
+ * cut - Cut the window out of the input, keeping the blocks of a
+ *     fraction frac of the ids, and summarize the result in sum
+ */
+static trace_t *cut(double frac, unsigned long long seed, summary_t *sum)
+{
+    const traceop_t *op;
+    trace_t *t = xmalloc(sizeof(trace_t));
+    int max = 1024, i, j, k, id, count, prev, first, batch, *open;
+    long req, nopen;
+
+    memset(t, 0, sizeof(*t));
+    t->weight = in->weight;
+    t->ops = xmalloc(max * sizeof(traceop_t));
+    sizes = xmalloc(max_samples * sizeof(long) + 1);
+    lives = xmalloc(max_samples * sizeof(long) + 1);
+    nsizes = nlives = live_bytes = peak_bytes = 0;
+    for (i = 0; i < in->num_ids; i++) {
+	new_id[i] = -1;
+	born[i] = -1;
+    }
+
+    /* Before the window, follow which blocks are live and how big */
+    for (req = 0; req < from; req++) {
+	op = &in->ops[req];
+	count = op->type == ALLOC_BATCH || op->type == FREE_BATCH ? op->count : 1;
+	for (j = 0; j < count; j++) {
+	    id = op->index + j;
+	    switch (op->type) {
+	    case FREE:
+	    case FREE_BATCH:
+		born[id] = -1;
+		break;
+	    case REALLOC:
+		if (born[id] >= 0) {
+		    cur_size[id] = op->size;
+		    break;
+		}
+		/* fall through: a realloc of a dead block allocates it */
+	    default:
+		born[id] = req;
+		cur_size[id] = op->size;
+		alloc_type[id] = op->type == ALLOC_BATCH || op->type == REALLOC ?
+		    ALLOC : op->type;
+		alloc_align[id] = op->align;
+		break;
+	    }
+	}
+    }
+
+    /* Open the window with the kept blocks live at its start */
+    open = xmalloc(in->num_ids * sizeof(int) + 1);
+    for (i = nopen = 0; i < in->num_ids; i++)
+	if (born[i] >= 0 && kept(i, frac, seed))
+	    open[nopen++] = i;
+    qsort(open, nopen, sizeof(int), cmp_born);
+    for (i = 0; i < nopen; i++) {
+	id = open[i];
+	emit(t, &max, alloc_type[id], t->num_ids, cur_size[id], 1,
+	     alloc_align[id]);
+	note_alloc(t, id, cur_size[id], born[id]);
+    }
+    free(open);
+
+    for (req = from; req < to; req++) {
+	op = &in->ops[req];
+	count = op->type == ALLOC_BATCH || op->type == FREE_BATCH ? op->count : 1;
+	switch (op->type) {
+	case FREE:
+	case FREE_BATCH:
+	    /* A batch whose kept blocks are still consecutive stays one */
+	    for (j = k = 0, prev = first = -1; j < count; j++) {
+		id = op->index + j;
+		if (new_id[id] < 0)
+		    continue;
+		if (k > 0 && new_id[id] != prev + 1)
+		    break;
+		if (k++ == 0)
+		    first = new_id[id];
+		prev = new_id[id];
+	    }
+	    if ((batch = j == count && k > 1))
+		emit(t, &max, FREE_BATCH, first, 0, k, 0);
+	    for (j = 0; j < count; j++) {
+		id = op->index + j;
+		if (new_id[id] < 0)
+		    continue;
+		if (!batch)
+		    emit(t, &max, FREE, new_id[id], 0, 1, 0);
+		note_free(id, req);
+	    }
+	    break;
+	case ALLOC_BATCH:
+	    for (j = k = 0; j < count; j++)
+		k += kept(op->index + j, frac, seed);
+	    if (k == 0)
+		break;
+	    emit(t, &max, k > 1 ? ALLOC_BATCH : ALLOC, t->num_ids, op->size, k, 0);
+	    for (j = 0; j < count; j++)
+		if (kept(op->index + j, frac, seed))
+		    note_alloc(t, op->index + j, op->size, req);
+	    break;
+	case REALLOC:
+	    id = op->index;
+	    if (new_id[id] >= 0) {
+		emit(t, &max, REALLOC, new_id[id], op->size, 0, 0);
+		live_bytes += op->size - cur_size[id];
+		if (live_bytes > peak_bytes)
+		    peak_bytes = live_bytes;
+		cur_size[id] = op->size;
+		sizes[nsizes++] = op->size;
+		break;
+	    }
+	    /* fall through: a realloc of a dead block allocates it */
+	default:
+	    id = op->index;
+	    if (!kept(id, frac, seed))
+		break;
+	    emit(t, &max, op->type, t->num_ids, op->size, 0, op->align);
+	    note_alloc(t, id, op->size, req);
+	    break;
+	}
+    }
+
+    /* Close the window, freeing what is still live */
+    for (id = 0; id < in->num_ids; id++)
+	if (new_id[id] >= 0) {
+	    emit(t, &max, FREE, new_id[id], 0, 1, 0);
+	    new_id[id] = -1;
+	}
+
+    t->sugg_heapsize = peak_bytes + 100 > INT_MAX ? INT_MAX : peak_bytes + 100;
+    qsort(sizes, nsizes, sizeof(long), cmp_long);
+    qsort(lives, nlives, sizeof(long), cmp_long);
+    sum->v[0] = quantile(sizes, nsizes, 0.5);
+    sum->v[1] = quantile(sizes, nsizes, 0.9);
+    for (i = 0, sum->v[2] = 0; i < nsizes; i++)
+	sum->v[2] += sizes[i];
+    sum->v[2] = nsizes ? sum->v[2] / nsizes : 0;
+    sum->v[3] = quantile(lives, nlives, 0.5);
+    sum->v[4] = quantile(lives, nlives, 0.9);
+    free(sizes);
+    free(lives);
+    return t;
+}
+
+/*
+ * kept - Whether the sample keeps id. A hash of id and seed rather
+ *     than a random number, so that every request on id agrees.
+ */
+static int kept(int id, double frac, unsigned long long seed)
+{
+    unsigned long long x = (unsigned long long)id + seed * 0x9E3779B97F4A7C15ULL;
+
+    if (frac >= 1)
+	return 1;
+    /* splitmix64 */
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return (x >> 11) * (1.0 / (1ULL << 53)) < frac;
+}
+
+/* emit - Append a request to t, growing its array as needed */
+static void emit(trace_t *t, int *max, int type, int index, int size,
+		 int count, int align)
+{
+    traceop_t *op;
+
+    if (t->num_ops == *max) {
+	*max *= 2;
+	if ((t->ops = realloc(t->ops, *max * sizeof(traceop_t))) == NULL) {
+	    fprintf(stderr, "Out of memory\n");
+	    exit(1);
+	}
+    }
+    op = &t->ops[t->num_ops++];
+    op->type = type;
+    op->index = index;
+    op->size = size;
+    op->count = type == ALLOC_BATCH || type == FREE_BATCH ? count : 0;
+    op->align = type == MEMALIGN ? align : 0;
+}
+
+/* note_alloc - Give id the next output id; it was allocated by req */
+static void note_alloc(trace_t *t, int id, int size, long req)
+{
+    new_id[id] = t->num_ids++;
+    cur_size[id] = size;
+    born[id] = req;
+    sizes[nsizes++] = size;
+    live_bytes += size;
+    if (live_bytes > peak_bytes)
+	peak_bytes = live_bytes;
+}
+
+/* note_free - id was freed by request req */
+static void note_free(int id, long req)
+{
+    lives[nlives++] = req - born[id];
+    live_bytes -= cur_size[id];
+    new_id[id] = -1;
+}
+
+/* parse_end - An end of a window: a request number or a percentage */
+static long parse_end(const char *s, long dflt)
+{
+    char *end;
+    double v;
+
+    if (*s == '\0')
+	return dflt;
+    v = strtod(s, &end);
+    if (*end == '%')
+	return (long)(v / 100 * in->num_ops);
+    if (*end != '\0')
+	return -1;
+    return (long)v;
+}
+
+/* distance - The largest relative difference between two summaries */
+static double distance(const summary_t *a, const summary_t *b)
+{
+    double d, max = 0;
+    int i;
+
+    for (i = 0; i < NSTATS; i++) {
+	d = fabs(b->v[i] - a->v[i]) / (a->v[i] > 0 ? a->v[i] : 1);
+	if (d > max)
+	    max = d;
+    }
+    return max;
+}
+
+/* quantile - The q-quantile of the n sorted values in v (nearest rank) */
+static double quantile(long *v, long n, double q)
+{
+    long i = (long)ceil(q * n) - 1;
+
+    if (n == 0)
+	return 0;
+    return v[i < 0 ? 0 : i];
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* cmp_born - Order ids by the request that allocated them */
+static int cmp_born(const void *a, const void *b)
+{
+    long x = born[*(const int *)a], y = born[*(const int *)b];
+
+    return (x > y) - (x < y);
+}
+
+static void *xmalloc(size_t size)
+{
+    void *p;
+
+    if ((p = malloc(size)) == NULL) {
+	fprintf(stderr, "Out of memory\n");
+	exit(1);
+    }
+    return p;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracecut [-bh] [-w <from>:<to>] [-s <fraction>] [-S <seed>]\n"
+	    "                [-t <tolerance>] [-o <file>] <trace>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b              Write a binary trace.\n");
+    fprintf(stderr, "\t-h              Print this message.\n");
+    fprintf(stderr, "\t-o <file>       Write the trace to <file> rather than stdout.\n");
+    fprintf(stderr, "\t-S <seed>       Seed the sample with <seed> (default 1).\n");
+    fprintf(stderr, "\t-s <fraction>   Keep the blocks of <fraction> of the ids.\n");
+    fprintf(stderr, "\t-t <tolerance>  Largest relative difference of the sample's\n"
+	    "\t                sizes and lifetimes (default 0.05).\n");
+    fprintf(stderr, "\t-w <from>:<to>  Keep requests <from> to <to> - 1; each is a\n"
+	    "\t                request number or a percentage.\n");
+}
@@ -0,0 +1,553 @@
+/*
+ * tracegen.c - Synthesize a trace from a description of the workload
+ *
+ * Usage: tracegen [-b] [-s <seed>] [-o <file>] <spec>
+ *
+ * The spec file has one directive per line; # starts a comment.
+ *
+ *   seed <n>                    seed of the generator (default 1; -s wins)
+ *   phase <n>                   start a phase of <n> allocations
+ *   size <dist>                 request sizes in bytes
+ *   life <dist>                 lifetimes, counted in allocations
+ *   life phase                  blocks live until the end of their phase
+ *   realloc <p> <factor> <n>    with probability <p> a block is resized
+ *                               <n> times over its life, each time to
+ *                               <factor> times its size
+ *   calloc <p>                  allocate with calloc with probability <p>
+ *   memalign <p> <align>        ... or with memalign(<align>)
+ *
+ * where a distribution <dist> is one of
+ *
+ *   fixed <v>
+ *   uniform <lo> <hi>
+ *   lognormal <median> <sigma>  (sigma of the log)
+ *   exp <mean>
+ *   hist <v>:<w> ...            value <v> with weight <w>; <v> may be a
+ *                               range <lo>-<hi>, drawn from uniformly
+ *   hist @<file>                the same entries, read from <file>
+ *
+ * Directives before the first phase directive set the defaults, and
+ * every phase starts with the settings of the one before it. Time runs
+ * in allocations: a block with lifetime L is freed just before the
+ * L-th allocation after its own, and its resizes are spread evenly
+ * over that time. Blocks still live at the end are freed, so the trace
+ * is balanced. The same spec and seed always give the same trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <math.h>
+
+#include "trace.h"
+
+#define MAXLINE 1024   /* max spec line */
+#define MAXPHASES 256  /* max phases in a spec */
+
+/* A distribution of sizes or lifetimes */
+typedef struct {
+    enum {D_FIXED, D_UNIFORM, D_LOGNORMAL, D_EXP, D_HIST, D_PHASE} kind;
+    double a, b;          /* parameters of the first four kinds */
+    int n;                /* histogram buckets */
+    long *lo, *hi;        /* bucket i has the values lo[i]..hi[i] ... */
+    double *cum;          /* ... and weight cum[i] - cum[i-1] */
+} dist_t;
+
+/* The settings of one phase */
+typedef struct {
+    long allocs;          /* allocations in the phase */
+    dist_t size, life;
+    double realloc_p, realloc_factor;
+    int realloc_steps;
+    double calloc_p, memalign_p;
+    int align;
+} phase_t;
+
+/* A free or resize, due before the allocation at time */
+typedef struct {
+    long time;
+    long seq;             /* ties go in the order scheduled */
+    int id;
+    int size;             /* new size of a resize, 0 for a free */
+} event_t;
+
+/* Is heap entry x due before heap entry y? */
+#define BEFORE(x, y) (heap[x].time < heap[y].time || \
+		      (heap[x].time == heap[y].time && heap[x].seq < heap[y].seq))
+
+static phase_t phases[MAXPHASES];
+static int nphases;
+static unsigned long long seed = 1;
+static int seed_set = 0;  /* -s given */
+
+static event_t *heap;     /* pending events, a binary min-heap */
+static long heap_n, heap_max, heap_seq;
+static trace_t out;       /* the trace being built */
+static int ops_max;
+static double live_bytes, peak_bytes;
+static int *live_size;    /* current size of each id */
+static int live_max;
+
+static const char *spec_file;
+static int spec_line;
+
+static void read_spec(const char *file);
+static void parse_dist(char **tok, int ntok, dist_t *d, int life_ok);
+static void read_hist_file(const char *file, dist_t *d);
+static void add_bucket(dist_t *d, const char *entry);
+static double uniform(void);
+static double normal(void);
+static long draw(const dist_t *d);
+static void generate(void);
+static void schedule(long time, int id, int size);
+static void run_events(long now);
+static void emit(int type, int id, int size, int align);
+static void spec_error(const char *msg);
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    char *outfile = NULL;
+    int binary = 0;
+    FILE *fp = stdout;
+    char c;
+
+    while ((c = getopt(argc, argv, "bs:o:h")) != EOF) {
+	switch (c) {
+	case 'b': /* Write a binary trace */
+	    binary = 1;
+	    break;
+	case 's': /* Seed, overriding the spec */
+	    seed = strtoull(optarg, NULL, 0);
+	    seed_set = 1;
+	    break;
+	case 'o': /* Output file */
+	    outfile = optarg;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind != argc - 1) {
+	usage();
+	exit(1);
+    }
+
+    read_spec(argv[optind]);
+    generate();
+
+    if (outfile && (fp = fopen(outfile, binary ? "wb" : "w")) == NULL) {
+	fprintf(stderr, "Could not create %s\n", outfile);
+	exit(1);
+    }
+    if (trace_write(fp, &out, binary) < 0 || (outfile && fclose(fp) != 0)) {
+	fprintf(stderr, "Could not write the trace\n");
+	exit(1);
+    }
+    fprintf(stderr, "%d requests, %d ids, peak live payload %.0f bytes\n",
+	    out.num_ops, out.num_ids, peak_bytes);
+    exit(0);
+}
+
+/*****************
+ * Reading the spec
+ *****************/
+
+/*
+ * read_spec - Read the phases from file
+ */
+static void read_spec(const char *file)
+{
+    FILE *fp;
+    char line[MAXLINE], *tok[64], *p;
+    phase_t defaults, *cur = &defaults;
+    int ntok;
+
+    memset(&defaults, 0, sizeof(defaults));
+    defaults.size.kind = D_FIXED;
+    defaults.size.a = 16;
+    defaults.life.kind = D_FIXED;
+    defaults.life.a = 1;
+    defaults.realloc_factor = 1;
+    defaults.align = 16;
+
+    spec_file = file;
+    if ((fp = fopen(file, "r")) == NULL) {
+	fprintf(stderr, "Could not open %s\n", file);
+	exit(1);
+    }
+    for (spec_line = 1; fgets(line, sizeof(line), fp) != NULL; spec_line++) {
+	if ((p = strchr(line, '#')) != NULL)
+	    *p = '\0';
+	for (ntok = 0, p = strtok(line, " \t\r\n"); p != NULL && ntok < 64;
+	     p = strtok(NULL, " \t\r\n"))
+	    tok[ntok++] = p;
+	if (ntok == 0)
+	    continue;
+
+	if (!strcmp(tok[0], "seed") && ntok == 2) {
+	    if (!seed_set)
+		seed = strtoull(tok[1], NULL, 0);
+	}
+	else if (!strcmp(tok[0], "phase") && ntok == 2) {
+	    if (nphases == MAXPHASES)
+		spec_error("too many phases");
+	    phases[nphases] = *cur;
+	    cur = &phases[nphases++];
+	    if ((cur->allocs = atol(tok[1])) <= 0)
+		spec_error("a phase needs at least one allocation");
+	}
+	else if (!strcmp(tok[0], "size") && ntok >= 2)
+	    parse_dist(tok + 1, ntok - 1, &cur->size, 0);
+	else if (!strcmp(tok[0], "life") && ntok >= 2)
+	    parse_dist(tok + 1, ntok - 1, &cur->life, 1);
+	else if (!strcmp(tok[0], "realloc") && ntok == 4) {
+	    cur->realloc_p = atof(tok[1]);
+	    cur->realloc_factor = atof(tok[2]);
+	    cur->realloc_steps = atoi(tok[3]);
+	    if (cur->realloc_factor <= 0 || cur->realloc_steps < 0)
+		spec_error("bad realloc chain");
+	}
+	else if (!strcmp(tok[0], "calloc") && ntok == 2)
+	    cur->calloc_p = atof(tok[1]);
+	else if (!strcmp(tok[0], "memalign") && ntok == 3) {
+	    cur->memalign_p = atof(tok[1]);
+	    cur->align = atoi(tok[2]);
+	    if (cur->align <= 0 || (cur->align & (cur->align - 1)) != 0)
+		spec_error("the alignment must be a power of 2");
+	}
+	else
+	    spec_error("unknown directive or wrong number of arguments");
+	if (cur->calloc_p + cur->memalign_p > 1)
+	    spec_error("calloc and memalign probabilities add up to more than 1");
+    }
+    fclose(fp);
+    if (nphases == 0) {
+	spec_line = 0;
+	spec_error("no phase directive");
+    }
+}
+
+/*
+ * parse_dist - Parse the distribution in tok[0..ntok-1]. Only lifetimes
+ *     (life_ok) can be "phase".
+ */
+static void parse_dist(char **tok, int ntok, dist_t *d, int life_ok)
+{
+    int i;
+
+    memset(d, 0, sizeof(*d));
+    if (!strcmp(tok[0], "fixed") && ntok == 2) {
+	d->kind = D_FIXED;
+	d->a = atof(tok[1]);
+    }
+    else if (!strcmp(tok[0], "uniform") && ntok == 3) {
+	d->kind = D_UNIFORM;
+	d->a = atof(tok[1]);
+	d->b = atof(tok[2]);
+	if (d->b < d->a)
+	    spec_error("empty uniform range");
+    }
+    else if (!strcmp(tok[0], "lognormal") && ntok == 3) {
+	d->kind = D_LOGNORMAL;
+	d->a = atof(tok[1]);
+	d->b = atof(tok[2]);
+	if (d->a <= 0 || d->b < 0)
+	    spec_error("bad lognormal parameters");
+	d->a = log(d->a);
+    }
+    else if (!strcmp(tok[0], "exp") && ntok == 2) {
+	d->kind = D_EXP;
+	d->a = atof(tok[1]);
+    }
+    else if (!strcmp(tok[0], "hist") && ntok >= 2) {
+	d->kind = D_HIST;
+	if (tok[1][0] == '@' && ntok == 2)
+	    read_hist_file(tok[1] + 1, d);
+	else
+	    for (i = 1; i < ntok; i++)
+		add_bucket(d, tok[i]);
+	if (d->n == 0 || d->cum[d->n - 1] <= 0)
+	    spec_error("empty histogram");
+    }
+    else if (!strcmp(tok[0], "phase") && ntok == 1 && life_ok)
+	d->kind = D_PHASE;
+    else
+	spec_error("bad distribution");
+}
+
+/* read_hist_file - Read histogram entries from file */
+static void read_hist_file(const char *file, dist_t *d)
+{
+    FILE *fp;
+    char line[MAXLINE], *p;
+
+    if ((fp = fopen(file, "r")) == NULL)
+	spec_error("could not open the histogram file");
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if ((p = strchr(line, '#')) != NULL)
+	    *p = '\0';
+	for (p = strtok(line, " \t\r\n"); p != NULL; p = strtok(NULL, " \t\r\n"))
+	    add_bucket(d, p);
+    }
+    fclose(fp);
+}
+
+/* add_bucket - Add a <v>:<w> or <lo>-<hi>:<w> entry to a histogram */
+static void add_bucket(dist_t *d, const char *entry)
+{
+    long lo, hi;
+    double w;
+    int n;
+
+    if (sscanf(entry, "%ld-%ld:%lf%n", &lo, &hi, &w, &n) == 3 &&
+	entry[n] == '\0')
+	;
+    else if (sscanf(entry, "%ld:%lf%n", &lo, &w, &n) == 2 && entry[n] == '\0')
+	hi = lo;
+    else
+	spec_error("bad histogram entry");
+    if (hi < lo || w < 0)
+	spec_error("bad histogram entry");
+
+    if ((d->n & (d->n - 1)) == 0) { /* grow at powers of 2 */
+	n = d->n ? 2 * d->n : 1;
+	if ((d->lo = realloc(d->lo, n * sizeof(long))) == NULL ||
+	    (d->hi = realloc(d->hi, n * sizeof(long))) == NULL ||
+	    (d->cum = realloc(d->cum, n * sizeof(double))) == NULL)
+	    spec_error("out of memory");
+    }
+    d->lo[d->n] = lo;
+    d->hi[d->n] = hi;
+    d->cum[d->n] = w + (d->n ? d->cum[d->n - 1] : 0);
+    d->n++;
+}
+
+static void spec_error(const char *msg)
+{
+    if (spec_line)
+	fprintf(stderr, "%s:%d: %s\n", spec_file, spec_line, msg);
+    else
+	fprintf(stderr, "%s: %s\n", spec_file, msg);
+    exit(1);
+}
+
+/****************
+ * Random numbers
+ ****************/
+
+/* uniform - Uniform in (0, 1), from xorshift64* */
+static double uniform(void)
+{
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return (((seed * 2685821657736338717ULL) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/* normal - Standard normal, by Box-Muller */
+static double normal(void)
+{
+    double u = uniform(), v = uniform();
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/*
+ * draw - A value from d, rounded to an integer (D_PHASE is up to the
+ *     caller)
+ */
+static long draw(const dist_t *d)
+{
+    double u, x = 0;
+    int lo, hi, mid;
+
+    switch (d->kind) {
+    case D_FIXED:
+	x = d->a;
+	break;
+    case D_UNIFORM:
+	x = floor(d->a + uniform() * (d->b - d->a + 1));
+	break;
+    case D_LOGNORMAL:
+	x = exp(d->a + d->b * normal());
+	break;
+    case D_EXP:
+	x = -d->a * log(uniform());
+	break;
+    case D_HIST:
+	/* Find the first bucket whose cumulative weight exceeds u */
+	u = uniform() * d->cum[d->n - 1];
+	for (lo = 0, hi = d->n - 1; lo < hi; ) {
+	    mid = (lo + hi) / 2;
+	    if (d->cum[mid] > u)
+		hi = mid;
+	    else
+		lo = mid + 1;
+	}
+	x = d->lo[lo] + floor(uniform() * (d->hi[lo] - d->lo[lo] + 1));
+	break;
+    case D_PHASE:
+	break;
+    }
+    if (x > INT_MAX)
+	return INT_MAX;
+    return x < 0 ? 0 : (long)(x + 0.5);
+}
+
+/******************
+ * Making the trace
+ ******************/
+
+/*
+ * generate - Run the phases, building the trace in out
+ */
+static void generate(void)
+{
+    phase_t *ph;
+    long now = 0, end, life, i;
+    int p, s, id, size, type;
+    double u, grown;
+
+    out.weight = 1;
+    for (p = 0; p < nphases; p++) {
+	ph = &phases[p];
+	end = now + ph->allocs;
+	for (i = 0; i < ph->allocs; i++) {
+	    run_events(++now);
+
+	    /* Allocate the next id */
+	    id = out.num_ids++;
+	    if ((size = draw(&ph->size)) < 1)
+		size = 1;
+	    u = uniform();
+	    type = u < ph->calloc_p ? CALLOC :
+		u < ph->calloc_p + ph->memalign_p ? MEMALIGN : ALLOC;
+	    emit(type, id, size, ph->align);
+
+	    /* Schedule its resizes and its free */
+	    if (ph->life.kind == D_PHASE)
+		life = end - now + 1;
+	    else if ((life = draw(&ph->life)) < 1)
+		life = 1;
+	    if (ph->realloc_steps > 0 && uniform() < ph->realloc_p) {
+		for (s = 1; s <= ph->realloc_steps; s++) {
+		    grown = ceil(size * ph->realloc_factor);
+		    size = grown > INT_MAX ? INT_MAX : grown < 1 ? 1 : grown;
+		    schedule(now + life * s / (ph->realloc_steps + 1), id, size);
+		}
+	    }
+	    schedule(now + life, id, 0);
+	}
+	run_events(end + 1);
+    }
+    run_events(LONG_MAX);
+    out.sugg_heapsize = peak_bytes + 100 > INT_MAX ? INT_MAX : peak_bytes + 100;
+}
+
+/*
+ * schedule - Resize id to size (or free it, if size is 0) before the
+ *     allocation at time
+ */
+static void schedule(long time, int id, int size)
+{
+    event_t e, tmp;
+    long i;
+
+    if (heap_n == heap_max) {
+	heap_max = heap_max ? 2 * heap_max : 1024;
+	if ((heap = realloc(heap, heap_max * sizeof(event_t))) == NULL) {
+	    fprintf(stderr, "Out of memory for pending frees\n");
+	    exit(1);
+	}
+    }
+    e.time = time;
+    e.seq = heap_seq++;
+    e.id = id;
+    e.size = size;
+    for (i = heap_n++, heap[i] = e; i > 0; i = (i - 1) / 2) {
+	if (BEFORE((i - 1) / 2, i))
+	    break;
+	tmp = heap[i];
+	heap[i] = heap[(i - 1) / 2];
+	heap[(i - 1) / 2] = tmp;
+    }
+}
+
+/*
+ * run_events - Emit the frees and resizes due before the allocation
+ *     at now, in order
+ */
+static void run_events(long now)
+{
+    event_t e, tmp;
+    long i, c;
+
+    while (heap_n > 0 && heap[0].time <= now) {
+	e = heap[0];
+	heap[0] = heap[--heap_n];
+	for (i = 0; (c = 2 * i + 1) < heap_n; i = c) {
+	    if (c + 1 < heap_n && BEFORE(c + 1, c))
+		c++;
+	    if (!BEFORE(c, i))
+		break;
+	    tmp = heap[i];
+	    heap[i] = heap[c];
+	    heap[c] = tmp;
+	}
+	emit(e.size ? REALLOC : FREE, e.id, e.size, 0);
+    }
+}
+
+/*
+ * emit - Append a request to the trace, keeping track of the live
+ *     payload
+ */
+static void emit(int type, int id, int size, int align)
+{
+    traceop_t *op;
+
+    if (out.num_ops == ops_max) {
+	ops_max = ops_max ? 2 * ops_max : 1 << 16;
+	if ((out.ops = realloc(out.ops, ops_max * sizeof(traceop_t))) == NULL) {
+	    fprintf(stderr, "Out of memory for %d requests\n", ops_max);
+	    exit(1);
+	}
+    }
+    if (id >= live_max) {
+	live_max = live_max ? 2 * live_max : 1 << 16;
+	if ((live_size = realloc(live_size, live_max * sizeof(int))) == NULL) {
+	    fprintf(stderr, "Out of memory for %d ids\n", live_max);
+	    exit(1);
+	}
+    }
+    op = &out.ops[out.num_ops++];
+    op->type = type;
+    op->index = id;
+    op->size = size;
+    op->count = 0;
+    op->align = type == MEMALIGN ? align : 0;
+
+    if (type == FREE)
+	live_bytes -= live_size[id];
+    else
+	live_bytes += size - (type == REALLOC ? live_size[id] : 0);
+    live_size[id] = type == FREE ? 0 : size;
+    if (live_bytes > peak_bytes)
+	peak_bytes = live_bytes;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracegen [-bh] [-s <seed>] [-o <file>] <spec>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-b         Write a binary trace.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-o <file>  Write the trace to <file> rather than stdout.\n");
+    fprintf(stderr, "\t-s <seed>  Seed the generator with <seed>, whatever the spec says.\n");
+}
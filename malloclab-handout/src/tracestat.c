@@ -0,0 +1,489 @@
+/*
+ * tracestat.c - Describe the workload in a trace
+ *
+ * Usage: tracestat [-ch] [-o <file>] <trace> ...
+ *
+ * For each trace, in either format, reports
+ *
+ *   - the request sizes: quantiles and a histogram by powers of two
+ *   - the peak of the live payload bytes and of the live blocks
+ *   - the lifetimes of blocks, counted in requests from the one that
+ *     allocated a block to the one that freed it
+ *   - the growth ratios of reallocs (new size / old size)
+ *   - the fraction of frees in LIFO order: those that free the live
+ *     block allocated (or reallocated) most recently
+ *
+ * Batch requests count as one request, and their blocks as separate
+ * allocations or frees, in id order. With -c the same numbers are
+ * written as CSV, one row per trace, for a spreadsheet or a script.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "trace.h"
+
+#define SIZE_BANDS 18   /* sizes up to 16, 32, ..., 1M bytes, and more */
+#define LIFE_BANDS 24   /* lifetimes of 1, 2-3, 4-7, ... requests */
+#define GROWTH_BANDS 7  /* see growth_edges */
+#define NTYPES (CALLOC + 1)
+
+/* Realloc growth bands: shrinking, same size, then up to each edge */
+static const double growth_edges[GROWTH_BANDS - 1] = {1, 1, 1.25, 1.5, 2, 4};
+static const char *const growth_names[GROWTH_BANDS] = {
+    "<1", "1", "1-1.25", "1.25-1.5", "1.5-2", "2-4", ">4"};
+static const char type_letters[NTYPES] = {
+    [ALLOC] = 'a', [FREE] = 'f', [REALLOC] = 'r', [ALLOC_BATCH] = 'A',
+    [FREE_BATCH] = 'F', [MEMALIGN] = 'm', [CALLOC] = 'c'};
+
+/* What one trace does */
+typedef struct {
+    long nops[NTYPES];          /* requests by type */
+    long *sizes;                /* size of every allocation and realloc */
+    long nsizes;
+    double size_sum;
+    long size_band[SIZE_BANDS];
+    long *lives;                /* lifetime of every freed block */
+    long nlives;
+    double life_sum;
+    long life_band[LIFE_BANDS];
+    long never_freed;           /* blocks live at the end */
+    long live_bytes, live_blocks;
+    long peak_bytes, peak_blocks;
+    long peak_bytes_at, peak_blocks_at; /* request of each peak */
+    long reallocs;              /* reallocs of live blocks */
+    double log_growth;          /* sum of the logs of their ratios */
+    long growth_band[GROWTH_BANDS];
+    long frees, lifo_frees;     /* frees of live blocks, and the LIFO ones */
+} stats_t;
+
+/* Per-id state while a trace is scanned */
+static long *cur_size;  /* payload of a live block, or -1 */
+static long *born;      /* request that allocated it */
+static int *prv, *nxt;  /* live blocks in allocation order, ... */
+static int youngest;    /* ... the last one being this, or -1 */
+
+static int scan(const trace_t *t, stats_t *s);
+static void allocated(stats_t *s, int id, long size, long req);
+static void reallocated(stats_t *s, int id, long size, long req);
+static void freed(stats_t *s, int id, long req);
+static void push(int id);
+static void unlink_id(int id);
+static void add_size(stats_t *s, long size);
+static void report(FILE *fp, const char *name, const trace_t *t, stats_t *s);
+static void csv_header(FILE *fp);
+static void csv_row(FILE *fp, const char *name, const trace_t *t, stats_t *s);
+static long quantile(const long *v, long n, double q);
+static int cmp_long(const void *a, const void *b);
+static int size_band(long size);
+static int life_band(long life);
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    FILE *fp = stdout;
+    char *outfile = NULL;
+    int csv = 0, errors = 0;
+    trace_t *t;
+    stats_t s;
+    char c;
+
+    while ((c = getopt(argc, argv, "co:h")) != EOF) {
+	switch (c) {
+	case 'c': /* Write CSV */
+	    csv = 1;
+	    break;
+	case 'o': /* Output file */
+	    outfile = optarg;
+	    break;
+	case 'h':
+	    usage();
+	    exit(0);
+	default:
+	    usage();
+	    exit(1);
+	}
+    }
+    if (optind == argc) {
+	usage();
+	exit(1);
+    }
+    if (outfile != NULL && (fp = fopen(outfile, "w")) == NULL) {
+	fprintf(stderr, "Could not open %s\n", outfile);
+	exit(1);
+    }
+
+    if (csv)
+	csv_header(fp);
+    for (; optind < argc; optind++) {
+	if ((t = trace_read(argv[optind])) == NULL) {
+	    errors++;
+	    continue;
+	}
+	if (scan(t, &s) < 0) {
+	    fprintf(stderr, "Out of memory for %s\n", argv[optind]);
+	    exit(1);
+	}
+	if (csv)
+	    csv_row(fp, argv[optind], t, &s);
+	else
+	    report(fp, argv[optind], t, &s);
+	free(s.sizes);
+	free(s.lives);
+	trace_free(t);
+    }
+    if (fp != stdout)
+	fclose(fp);
+    exit(errors != 0);
+}
+
+/*
+ * scan - Replay t on the per-id state and collect its statistics in s
+ */
+static int scan(const trace_t *t, stats_t *s)
+{
+    const traceop_t *op;
+    long i;
+    int j;
+
+    memset(s, 0, sizeof(*s));
+    cur_size = malloc(t->num_ids * sizeof(long) + 1);
+    born = malloc(t->num_ids * sizeof(long) + 1);
+    prv = malloc(t->num_ids * sizeof(int) + 1);
+    nxt = malloc(t->num_ids * sizeof(int) + 1);
+    /* Every allocation, batch members included, and every realloc
+       adds a size; at most one block is freed per size */
+    for (i = 0; i < t->num_ops; i++) {
+	op = &t->ops[i];
+	s->nsizes += op->type == ALLOC_BATCH ? op->count :
+	    op->type == FREE || op->type == FREE_BATCH ? 0 : 1;
+    }
+    s->sizes = malloc(s->nsizes * sizeof(long) + 1);
+    s->lives = malloc(s->nsizes * sizeof(long) + 1);
+    if (!cur_size || !born || !prv || !nxt || !s->sizes || !s->lives)
+	return -1;
+    s->nsizes = 0;
+    for (i = 0; i < t->num_ids; i++)
+	cur_size[i] = -1;
+    youngest = -1;
+
+    for (i = 0; i < t->num_ops; i++) {
+	op = &t->ops[i];
+	s->nops[op->type]++;
+	switch (op->type) {
+	case ALLOC:
+	case CALLOC:
+	case MEMALIGN:
+	    allocated(s, op->index, op->size, i);
+	    break;
+	case ALLOC_BATCH:
+	    for (j = 0; j < op->count; j++)
+		allocated(s, op->index + j, op->size, i);
+	    break;
+	case REALLOC:
+	    reallocated(s, op->index, op->size, i);
+	    break;
+	case FREE:
+	    freed(s, op->index, i);
+	    break;
+	case FREE_BATCH:
+	    for (j = 0; j < op->count; j++)
+		freed(s, op->index + j, i);
+	    break;
+	}
+    }
+    s->never_freed = s->live_blocks;
+
+    qsort(s->sizes, s->nsizes, sizeof(long), cmp_long);
+    qsort(s->lives, s->nlives, sizeof(long), cmp_long);
+    free(cur_size);
+    free(born);
+    free(prv);
+    free(nxt);
+    return 0;
+}
+
+/* allocated - Block id of size bytes was allocated by request req */
+static void allocated(stats_t *s, int id, long size, long req)
+{
+    if (cur_size[id] >= 0) {  /* allocated twice; forget the first */
+	s->live_blocks--;
+	s->live_bytes -= cur_size[id];
+	unlink_id(id);
+    }
+    add_size(s, size);
+    cur_size[id] = size;
+    born[id] = req;
+    push(id);
+    s->live_blocks++;
+    s->live_bytes += size;
+    if (s->live_blocks > s->peak_blocks) {
+	s->peak_blocks = s->live_blocks;
+	s->peak_blocks_at = req;
+    }
+    if (s->live_bytes > s->peak_bytes) {
+	s->peak_bytes = s->live_bytes;
+	s->peak_bytes_at = req;
+    }
+}
+
+/*
+ * reallocated - Block id was resized to size bytes by request req. Like
+ *     mdriver, a realloc of a block that isn't live allocates it.
+ */
+static void reallocated(stats_t *s, int id, long size, long req)
+{
+    long old = cur_size[id];
+    double ratio;
+    int i;
+
+    if (old < 0) {
+	allocated(s, id, size, req);
+	return;
+    }
+    add_size(s, size);
+    s->reallocs++;
+    ratio = (double)size / (old > 0 ? old : 1);
+    s->log_growth += log(ratio);
+    if (ratio < 1)
+	i = 0;
+    else if (ratio == 1)
+	i = 1;
+    else
+	for (i = 2; i < GROWTH_BANDS - 1 && ratio > growth_edges[i]; i++)
+	    ;
+    s->growth_band[i]++;
+
+    cur_size[id] = size;
+    unlink_id(id);
+    push(id);  /* the block is as good as new for LIFO order */
+    s->live_bytes += size - old;
+    if (s->live_bytes > s->peak_bytes) {
+	s->peak_bytes = s->live_bytes;
+	s->peak_bytes_at = req;
+    }
+}
+
+/* freed - Block id was freed by request req */
+static void freed(stats_t *s, int id, long req)
+{
+    long life;
+
+    if (cur_size[id] < 0)  /* not live: nothing to free */
+	return;
+    s->frees++;
+    if (id == youngest)
+	s->lifo_frees++;
+    life = req - born[id];
+    s->lives[s->nlives++] = life;
+    s->life_sum += life;
+    s->life_band[life_band(life)]++;
+    s->live_blocks--;
+    s->live_bytes -= cur_size[id];
+    cur_size[id] = -1;
+    unlink_id(id);
+}
+
+/* push - Append id to the list of live blocks, as the youngest */
+static void push(int id)
+{
+    prv[id] = youngest;
+    nxt[id] = -1;
+    if (youngest >= 0)
+	nxt[youngest] = id;
+    youngest = id;
+}
+
+static void unlink_id(int id)
+{
+    if (prv[id] >= 0)
+	nxt[prv[id]] = nxt[id];
+    if (nxt[id] >= 0)
+	prv[nxt[id]] = prv[id];
+    else
+	youngest = prv[id];
+}
+
+static void add_size(stats_t *s, long size)
+{
+    s->sizes[s->nsizes++] = size;
+    s->size_sum += size;
+    s->size_band[size_band(size)]++;
+}
+
+/*
+ * report - Print the statistics of trace name for people
+ */
+static void report(FILE *fp, const char *name, const trace_t *t, stats_t *s)
+{
+    char label[32];
+    long lo;
+    int i, sep = 0;
+
+    fprintf(fp, "%s: %d requests (", name, t->num_ops);
+    for (i = 0; i < NTYPES; i++)
+	if (s->nops[i] != 0)
+	    fprintf(fp, "%s%c %ld", sep++ ? ", " : "", type_letters[i], s->nops[i]);
+    fprintf(fp, "), %d ids\n", t->num_ids);
+
+    if (s->nsizes != 0) {
+	fprintf(fp, "Sizes: min %ld, median %ld, mean %.1f, p90 %ld, p99 %ld, max %ld\n",
+		s->sizes[0], quantile(s->sizes, s->nsizes, 0.5),
+		s->size_sum / s->nsizes, quantile(s->sizes, s->nsizes, 0.9),
+		quantile(s->sizes, s->nsizes, 0.99), s->sizes[s->nsizes - 1]);
+	fprintf(fp, "  %-16s %10s %6s\n", "bytes", "requests", "%");
+	for (i = 0, lo = 0; i < SIZE_BANDS; lo = (16L << i++) + 1) {
+	    if (s->size_band[i] == 0)
+		continue;
+	    if (i == SIZE_BANDS - 1)
+		sprintf(label, ">=%ld", lo);
+	    else
+		sprintf(label, "%ld-%ld", lo, 16L << i);
+	    fprintf(fp, "  %-16s %10ld %6.1f\n", label, s->size_band[i],
+		    100.0 * s->size_band[i] / s->nsizes);
+	}
+    }
+
+    fprintf(fp, "Live: peak %ld bytes at request %ld, peak %ld blocks at request %ld\n",
+	    s->peak_bytes, s->peak_bytes_at, s->peak_blocks, s->peak_blocks_at);
+
+    fprintf(fp, "Lifetimes (requests): ");
+    if (s->nlives != 0)
+	fprintf(fp, "median %ld, mean %.1f, p90 %ld, p99 %ld, max %ld; ",
+		quantile(s->lives, s->nlives, 0.5), s->life_sum / s->nlives,
+		quantile(s->lives, s->nlives, 0.9),
+		quantile(s->lives, s->nlives, 0.99), s->lives[s->nlives - 1]);
+    fprintf(fp, "%ld blocks never freed\n", s->never_freed);
+    if (s->nlives != 0) {
+	fprintf(fp, "  %-16s %10s %6s\n", "requests", "blocks", "%");
+	for (i = 0; i < LIFE_BANDS; i++) {
+	    if (s->life_band[i] == 0)
+		continue;
+	    if (i == LIFE_BANDS - 1)
+		sprintf(label, ">=%ld", 1L << i);
+	    else if (i == 0)
+		sprintf(label, "1");
+	    else
+		sprintf(label, "%ld-%ld", 1L << i, (2L << i) - 1);
+	    fprintf(fp, "  %-16s %10ld %6.1f\n", label, s->life_band[i],
+		    100.0 * s->life_band[i] / s->nlives);
+	}
+    }
+
+    if (s->reallocs != 0) {
+	fprintf(fp, "Realloc growth: %ld reallocs, geometric mean ratio %.3f\n",
+		s->reallocs, exp(s->log_growth / s->reallocs));
+	fprintf(fp, "  %-16s %10s %6s\n", "ratio", "reallocs", "%");
+	for (i = 0; i < GROWTH_BANDS; i++)
+	    if (s->growth_band[i] != 0)
+		fprintf(fp, "  %-16s %10ld %6.1f\n", growth_names[i],
+			s->growth_band[i], 100.0 * s->growth_band[i] / s->reallocs);
+    }
+
+    fprintf(fp, "LIFO frees: %ld of %ld (%.1f%%)\n\n", s->lifo_frees, s->frees,
+	    s->frees ? 100.0 * s->lifo_frees / s->frees : 0.0);
+}
+
+/*
+ * csv_header - The names of the columns written by csv_row. Histogram
+ *     columns are named by the lower end of their band.
+ */
+static void csv_header(FILE *fp)
+{
+    int i;
+
+    fprintf(fp, "trace,requests,ids");
+    for (i = 0; i < NTYPES; i++)
+	fprintf(fp, ",ops_%c", type_letters[i]);
+    fprintf(fp, ",size_min,size_median,size_mean,size_p90,size_p99,size_max"
+	    ",peak_bytes,peak_blocks,life_median,life_mean,life_p90,life_p99"
+	    ",life_max,never_freed,reallocs,growth_geomean,lifo_frees,frees");
+    for (i = 0; i < SIZE_BANDS; i++)
+	fprintf(fp, ",size_%ld", i == 0 ? 0 : (16L << (i - 1)) + 1);
+    for (i = 0; i < LIFE_BANDS; i++)
+	fprintf(fp, ",life_%ld", 1L << i);
+    for (i = 0; i < GROWTH_BANDS; i++)
+	fprintf(fp, ",growth_%s", growth_names[i]);
+    fprintf(fp, "\n");
+}
+
+/*
+ * csv_row - Write the statistics of trace name as one CSV row
+ */
+static void csv_row(FILE *fp, const char *name, const trace_t *t, stats_t *s)
+{
+    int i;
+
+    fprintf(fp, "%s,%d,%d", name, t->num_ops, t->num_ids);
+    for (i = 0; i < NTYPES; i++)
+	fprintf(fp, ",%ld", s->nops[i]);
+    fprintf(fp, ",%ld,%ld,%.1f,%ld,%ld,%ld",
+	    s->nsizes ? s->sizes[0] : 0, quantile(s->sizes, s->nsizes, 0.5),
+	    s->nsizes ? s->size_sum / s->nsizes : 0.0,
+	    quantile(s->sizes, s->nsizes, 0.9), quantile(s->sizes, s->nsizes, 0.99),
+	    s->nsizes ? s->sizes[s->nsizes - 1] : 0);
+    fprintf(fp, ",%ld,%ld", s->peak_bytes, s->peak_blocks);
+    fprintf(fp, ",%ld,%.1f,%ld,%ld,%ld,%ld",
+	    quantile(s->lives, s->nlives, 0.5),
+	    s->nlives ? s->life_sum / s->nlives : 0.0,
+	    quantile(s->lives, s->nlives, 0.9), quantile(s->lives, s->nlives, 0.99),
+	    s->nlives ? s->lives[s->nlives - 1] : 0, s->never_freed);
+    fprintf(fp, ",%ld,%.4f,%ld,%ld", s->reallocs,
+	    s->reallocs ? exp(s->log_growth / s->reallocs) : 0.0,
+	    s->lifo_frees, s->frees);
+    for (i = 0; i < SIZE_BANDS; i++)
+	fprintf(fp, ",%ld", s->size_band[i]);
+    for (i = 0; i < LIFE_BANDS; i++)
+	fprintf(fp, ",%ld", s->life_band[i]);
+    for (i = 0; i < GROWTH_BANDS; i++)
+	fprintf(fp, ",%ld", s->growth_band[i]);
+    fprintf(fp, "\n");
+}
+
+/* quantile - The q-quantile of the n sorted values in v (nearest rank) */
+static long quantile(const long *v, long n, double q)
+{
+    long i = (long)ceil(q * n) - 1;
+
+    if (n == 0)
+	return 0;
+    return v[i < 0 ? 0 : i];
+}
+
+static int cmp_long(const void *a, const void *b)
+{
+    long x = *(const long *)a, y = *(const long *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* size_band - Band 0 has sizes up to 16 bytes, band i up to 16 << i */
+static int size_band(long size)
+{
+    int i;
+
+    for (i = 0; i < SIZE_BANDS - 1 && size > (16L << i); i++)
+	;
+    return i;
+}
+
+/* life_band - Band i has lifetimes from 2^i to 2^(i+1) - 1 */
+static int life_band(long life)
+{
+    int i;
+
+    for (i = 0; i < LIFE_BANDS - 1 && life >= (2L << i); i++)
+	;
+    return i;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: tracestat [-ch] [-o <file>] <trace> ...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-c         Write CSV, one row per trace.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-o <file>  Write to <file> rather than stdout.\n");
+}
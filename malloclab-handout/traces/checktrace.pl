@@ -81,37 +81,55 @@ while ($line = <STDIN>) {
     # save the line for output later
     $lines[$requestnum++] = $line;
 
-    #ignore realloc requests, as long as they are preceeded by an alloc request
-    if ($cmd eq "r") {
-	if (!$HASH{$id}) {
-	    die "$0: ERROR[$linenum]: realloc without previous alloc\n";
-	}
-	next;
+    # an aligned allocate "m <id> <align> <bytes>" and a zeroed
+    # allocate "c <id> <bytes>" are allocates
+    if ($cmd eq "m" or $cmd eq "c") {
+	$cmd = "a";
     }
 
-    if ($cmd eq "a" and $HASH{$id} eq "a") {
-	die "$0: ERROR[$linenum]: allocate with no intervening free.\n";
+    # batch requests "A <id> <count> <bytes>" and "F <id> <count>"
+    # stand for one a or f request on each of ids id..id+count-1
+    if ($cmd eq "A" or $cmd eq "F") {
+	$cmd = lc($cmd);
+	@ids = ($id .. $id + $size - 1);
     }
-
-    if ($cmd eq "a" and $HASH{$id} eq "f") {
-	die "$0: ERROR[$linenum]: reused ID $id.\n";
+    else {
+	@ids = ($id);
     }
+    foreach $id (@ids) {
+
+	#ignore realloc requests, as long as they are preceeded by an alloc request
+	if ($cmd eq "r") {
+	    if (!$HASH{$id}) {
+		die "$0: ERROR[$linenum]: realloc without previous alloc\n";
+	    }
+	    next;
+	}
 
-    if ($cmd eq "f" and !exists($HASH{$id})) {
-	die "$0: ERROR[$linenum]: freeing unallocated block.\n";
-	next;
-    }
+	if ($cmd eq "a" and $HASH{$id} eq "a") {
+	    die "$0: ERROR[$linenum]: allocate with no intervening free.\n";
+	}
 
-    if ($cmd eq "f" and !$HASH{$id} eq "f") {
-	die "$0: ERROR[$linenum]: freeing already freed block.\n";
-	next;
-    }
+	if ($cmd eq "a" and $HASH{$id} eq "f") {
+	    die "$0: ERROR[$linenum]: reused ID $id.\n";
+	}
+
+	if ($cmd eq "f" and !exists($HASH{$id})) {
+	    die "$0: ERROR[$linenum]: freeing unallocated block.\n";
+	    next;
+	}
+
+	if ($cmd eq "f" and !$HASH{$id} eq "f") {
+	    die "$0: ERROR[$linenum]: freeing already freed block.\n";
+	    next;
+	}
     
-    if ($cmd eq "f") {
-	delete $HASH{$id};
-    }
-    else {
-	$HASH{$id} = $cmd;
+	if ($cmd eq "f") {
+	    delete $HASH{$id};
+	}
+	else {
+	    $HASH{$id} = $cmd;
+	}
     }
 }
 
@@ -0,0 +1,78 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+$out_filename = "aligned.rep";
+$num_blocks = 4000;
+$max_small_size = 256;
+$max_simd_size = 4096;
+$simd_align = 64;
+$page_align = 4096;
+$large_size = 1 << 20;
+
+# Same seed every time, so the trace can be regenerated
+srand(1);
+
+# Create trace
+# Half of the blocks are small unaligned objects. The others are SIMD
+# buffers aligned to $simd_align bytes, and every 16th block is a page
+# aligned I/O buffer of one to four pages. Every 512th of those is a
+# large one of at least $large_size bytes.
+for ($i = 0;  $i < $num_blocks; $i += 1) {
+    $op = {};
+    $op->{seq} = $i;
+    if ($i % 512 == 511) {
+	$op->{type} = "m";
+	$op->{align} = $page_align;
+	$op->{size} = $large_size + $page_align * int(rand 4);
+    } elsif ($i % 16 == 15) {
+	$op->{type} = "m";
+	$op->{align} = $page_align;
+	$op->{size} = $page_align * (1 + int(rand 4));
+    } elsif ($i % 2 == 1) {
+	$op->{type} = "m";
+	$op->{align} = $simd_align;
+	$op->{size} = $simd_align * (1 + int(rand($max_simd_size / $simd_align)));
+    } else {
+	$op->{type} = "a";
+	$op->{size} = 1 + int(rand $max_small_size);
+    }
+    $total_block_size += $op->{size};
+    push @trace, $op;
+}
+# Insert free()s in proper places
+for ($i = 0;  $i < $num_blocks; $i += 1) {
+    for ($minval = $i; $minval < $num_blocks + $i; $minval += 1) {
+        if (($trace[$minval]->{type} ne "f") && ($trace[$minval]->{seq} == $i)) {
+            last;
+        }
+    }
+    $pos = int(rand($num_blocks + $i - $minval - 1) + $minval + 1);
+    $op = {};
+    $op->{type} = "f";
+    $op->{seq} = $i;
+    splice @trace, $pos, 0, $op;
+}
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+# Calculate misc parameters
+$suggested_heap_size = $total_block_size + 100;
+$num_ops = 2*$num_blocks;
+
+print OUTFILE "$suggested_heap_size\n";
+print OUTFILE "$num_blocks\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n";
+
+for ($i = 0;  $i < 2*$num_blocks; $i += 1) {
+    if ($trace[$i]->{type} eq "a") {
+        print OUTFILE "a $trace[$i]->{seq} $trace[$i]->{size}\n";
+    } elsif ($trace[$i]->{type} eq "m") {
+        print OUTFILE "m $trace[$i]->{seq} $trace[$i]->{align} $trace[$i]->{size}\n";
+    } else {
+        print OUTFILE "f $trace[$i]->{seq}\n";
+    }
+}
+
+close OUTFILE;
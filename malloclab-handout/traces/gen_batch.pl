@@ -0,0 +1,47 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+$out_filename = "batch.rep";
+$batch_count = 256;
+$num_ticks = 200;
+$live_ticks = 2;
+$ctl_size = 40;
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+# Calculate misc parameters
+# Each tick allocates a batch of same-sized message buffers and frees
+# the batch of $live_ticks ticks ago in one request, like a message
+# pipeline. One small control block per tick lives across the batches.
+
+$num_blocks = $num_ticks * ($batch_count + 1);
+$num_ops = 2 * $num_ticks + ($num_ticks - $live_ticks) + $num_ticks - 1;
+$suggested_heap_size = ($live_ticks + 1) * $batch_count * 512
+    + $num_ticks * $ctl_size + 100;
+
+print OUTFILE "$suggested_heap_size\n";
+print OUTFILE "$num_blocks\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n";
+
+$id = 0;
+for ($t = 0;  $t < $num_ticks; $t += 1) {
+    $msg_size = 16 + ($t * 37) % 480;
+    $batch_id[$t] = $id;
+    print OUTFILE "A $id $batch_count $msg_size\n";
+    $id += $batch_count;
+
+    $ctl_id[$t] = $id;
+    print OUTFILE "a $id $ctl_size\n";
+    $id += 1;
+    if ($t > 0) {
+	print OUTFILE "f $ctl_id[$t-1]\n";
+    }
+
+    if ($t >= $live_ticks) {
+	print OUTFILE "F $batch_id[$t-$live_ticks] $batch_count\n";
+    }
+}
+
+close OUTFILE;
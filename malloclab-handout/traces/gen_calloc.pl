@@ -0,0 +1,52 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+$out_filename = "calloc.rep";
+$num_phases = 4;
+$per_phase = 1000;
+$max_array_size = 8192;
+$max_node_size = 64;
+
+# Same seed every time, so the trace can be regenerated
+srand(1);
+
+# Create trace
+# Each phase callocs arrays (three out of four blocks) mixed with small
+# malloc'ed nodes, then frees two thirds of the live blocks at random.
+# The first phase runs on a fresh heap; later phases reuse the holes the
+# earlier ones left and grow the heap again when those run out.
+$seq = 0;
+@live = ();
+for ($p = 0;  $p < $num_phases; $p += 1) {
+    for ($k = 0;  $k < $per_phase; $k += 1) {
+	if (rand() < 0.75) {
+	    push @trace, "c $seq " . (8 * (1 + int(rand($max_array_size / 8))));
+	} else {
+	    push @trace, "a $seq " . (1 + int(rand $max_node_size));
+	}
+	push @live, $seq;
+	$seq += 1;
+    }
+    for ($k = @live - 1;  $k > 0; $k -= 1) {
+	$j = int(rand($k + 1));
+	@live[$k, $j] = @live[$j, $k];
+    }
+    $num_free = int(2 * @live / 3);
+    push @trace, "f $_" foreach splice(@live, 0, $num_free);
+}
+push @trace, "f $_" foreach @live;
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+# Calculate misc parameters
+$suggested_heap_size = $seq * $max_array_size;
+$num_ops = 2*$seq;
+
+print OUTFILE "$suggested_heap_size\n";
+print OUTFILE "$seq\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n";
+print OUTFILE "$_\n" foreach @trace;
+
+close OUTFILE;
@@ -0,0 +1,37 @@
+# server.spec - tracegen model of a request-serving process
+#
+# Start-up builds tables that live for the whole run. Then requests
+# come in: mostly short-lived small objects with log-normal sizes, some
+# request buffers that double in size a few times, and now and then a
+# page-aligned I/O buffer. Halfway through, a cache refill allocates a
+# burst of larger blocks that are all dropped together.
+#
+#   unix> ../src/tracegen -o server.rep server.spec
+
+seed 42
+
+# Start-up
+phase 2000
+size hist 16:40 32:25 64:15 128-512:15 4096-16384:5
+life fixed 1000000000
+
+# Serving requests
+phase 200000
+size lognormal 48 1.0
+life exp 200
+realloc 0.02 2 4
+memalign 0.01 4096
+
+# Cache refill
+phase 2000
+size uniform 1024 8192
+life phase
+realloc 0 1 0
+memalign 0 16
+
+# Serving requests again
+phase 200000
+size lognormal 48 1.0
+life exp 200
+realloc 0.02 2 4
+memalign 0.01 4096